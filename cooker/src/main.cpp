@@ -0,0 +1,66 @@
+#include <exception>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+#include "resource/types/mesh_format.hpp"
+#include "resource/types/mesh_resource.hpp"
+#include "resource/types/texture_format.hpp"
+#include "resource/types/texture_resource.hpp"
+#include "util/print.hpp"
+
+namespace
+{
+  void CookMesh(const std::string& input, const std::string& output, const bool full_precision)
+  {
+    const auto data = LoadObjMeshData(input, full_precision ? VertexFormat::kFull : VertexFormat::kQuantized);
+    mesh_format::Write(output, data);
+    util::println("Cooked {} ({} vertices, {} indices, {} KiB of vertex data, {} KiB as floats)", output,
+                  data.VertexCount(), data.indices.size(), data.VertexBytes() / 1024,
+                  data.VertexCount() * sizeof(Vertex) / 1024);
+  }
+
+  void CookTexture(const std::string& input, const std::string& output)
+  {
+    const auto texture = LoadSourceTextureData(input);
+    texture_format::Write(output, texture);
+    util::println("Cooked {} ({}x{}, {} mips, {} KiB, {} KiB as rgba8)", output, texture.width(), texture.height(),
+                  texture.mips.size(), texture.data.size() / 1024,
+                  static_cast<uint64_t>(texture.width()) * texture.height() * 4 / 1024);
+  }
+} // namespace
+
+// Offline asset cooker, turns source assets into the binary formats the runtime maps directly.
+//   cooker <input.obj> <output.pmesh> [--full-precision]
+//   cooker <input image> <output.ptex>
+// Vertices are quantized unless --full-precision is passed. Textures get a full mip chain and are block compressed.
+int main(const int argc, char** argv)
+{
+  const bool full_precision = argc == 4 && std::string_view(argv[3]) == "--full-precision";
+  if (argc != 3 && !full_precision)
+  {
+    util::println("usage: {} <input.obj> <output.pmesh> [--full-precision]", argv[0]);
+    util::println("       {} <input image> <output.ptex>", argv[0]);
+    return 1;
+  }
+
+  const std::string input = argv[1];
+  const std::string output = argv[2];
+
+  try
+  {
+    if (std::filesystem::path(output).extension() == texture_format::kExtension)
+    {
+      CookTexture(input, output);
+    } else
+    {
+      CookMesh(input, output, full_precision);
+    }
+  } catch (const std::exception& err)
+  {
+    util::println("Failed to cook {}: {}", input, err.what());
+    return 1;
+  }
+
+  return 0;
+}
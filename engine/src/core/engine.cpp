@@ -4,7 +4,10 @@
 #include <memory>
 
 #include "core/imgui.hpp"
+#include "core/job_system.hpp"
+#include "ecs/render_object_sync.hpp"
 #include "ecs/scene.hpp"
+#include "ecs/transform_hierarchy.hpp"
 #include "events.hpp"
 #include "input/input.hpp"
 #include "render/vk_renderer.hpp"
@@ -25,14 +28,17 @@ Engine::Engine()
   const auto width = static_cast<uint32_t>(static_cast<float>(display_width) / 1.5F);
   const auto height = static_cast<uint32_t>(static_cast<float>(display_height) / 1.5F);
 
+  job_system_ = std::make_unique<JobSystem>();
   event_manager_ = std::make_unique<EventManager>();
   window_ = std::make_unique<Window>(
       WindowInfo{.width = width, .height = height, .fullscreen = false, .title = "meowl"}, *event_manager_);
   input_ = std::make_unique<Input>(*event_manager_);
-  resource_manager_ = std::make_unique<ResourceManager>();
+  resource_manager_ = std::make_unique<ResourceManager>(*job_system_);
   im_gui_system::Initialize(window_.get());
-  renderer_ = std::make_unique<VulkanRenderer>(window_.get(), *resource_manager_, *event_manager_);
+  renderer_ = std::make_unique<VulkanRenderer>(window_.get(), *resource_manager_, *event_manager_, *job_system_);
   scene_ = std::make_unique<Scene>();
+  transform_hierarchy_ = std::make_unique<TransformHierarchy>(scene_->registry(), *job_system_);
+  render_object_sync_ = std::make_unique<RenderObjectSync>(scene_->registry(), *renderer_, *job_system_);
 
   util::println("Engine initialized");
 }
@@ -74,3 +80,9 @@ Scene& Engine::GetScene() const
   assert(scene_ && "No scene!");
   return *scene_;
 }
+
+JobSystem& Engine::GetJobSystem() const
+{
+  assert(job_system_ && "No job system!");
+  return *job_system_;
+}
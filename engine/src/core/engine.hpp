@@ -9,6 +9,9 @@ class ResourceManager;
 class VulkanRenderer;
 class Engine;
 class Scene;
+class RenderObjectSync;
+class TransformHierarchy;
+class JobSystem;
 
 template<typename T>
 concept Application = requires(T app, float delta_time, Engine& engine) {
@@ -38,6 +41,7 @@ public:
   [[nodiscard]] ResourceManager& GetResourceManager() const;
   [[nodiscard]] VulkanRenderer& GetRenderer() const;
   [[nodiscard]] Scene& GetScene() const;
+  [[nodiscard]] JobSystem& GetJobSystem() const;
 
 private:
   std::unique_ptr<EventManager> event_manager_;
@@ -46,6 +50,10 @@ private:
   std::unique_ptr<ResourceManager> resource_manager_;
   std::unique_ptr<VulkanRenderer> renderer_;
   std::unique_ptr<Scene> scene_;
+  std::unique_ptr<TransformHierarchy> transform_hierarchy_;
+  std::unique_ptr<RenderObjectSync> render_object_sync_;
+  // last, its workers are joined before anything their jobs touch is destroyed
+  std::unique_ptr<JobSystem> job_system_;
 };
 
 #include "engine.inl" // IWYU pragma: keep
@@ -5,7 +5,9 @@
 #include "ecs/components/camera_component.hpp"
 #include "ecs/components/mesh_component.hpp"
 #include "ecs/components/transform_component.hpp"
+#include "ecs/render_object_sync.hpp"
 #include "ecs/scene.hpp"
+#include "ecs/transform_hierarchy.hpp"
 #include "events.hpp"
 #include "input/input.hpp"
 #include "render/vk_renderer.hpp"
@@ -38,6 +40,7 @@ void Engine::Run(App& app)
     window_->update();
     input_->update();
     renderer_->ClearLines();
+    resource_manager_->Update();
 
     app.Update(delta_time);
 
@@ -48,15 +51,8 @@ void Engine::Run(App& app)
       accumulator -= fixed_dt;
     }
 
-    auto view = scene_->registry().view<CMesh, CTransform>();
-    renderer_->ClearMeshes(view.size_hint());
-    for (const auto entity: view)
-    {
-      const auto& mesh_comp = view.get<CMesh>(entity);
-      const auto& mesh = *mesh_comp.mesh;
-      const auto& transform = view.get<CTransform>(entity);
-      renderer_->RenderMesh(transform.world, mesh.renderer_id, mesh.texture_id);
-    }
+    transform_hierarchy_->Update();
+    render_object_sync_->Update();
 
     const auto camera_view = scene_->registry().view<CCamera, CTransform>();
     entt::entity camera_entity = entt::null;
@@ -0,0 +1,165 @@
+#include "file_watcher.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <map>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+
+#include "tracy/Tracy.hpp"
+#include "util/print.hpp"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+  // how long the thread sleeps before it looks at the stop token again
+  constexpr auto kWakeInterval = std::chrono::milliseconds(100);
+  constexpr auto kPollInterval = std::chrono::milliseconds(250);
+
+  // the directories and every directory below them, missing ones are skipped
+  std::vector<std::filesystem::path> ListDirectories(const std::vector<std::filesystem::path>& roots)
+  {
+    std::vector<std::filesystem::path> directories;
+    for (const auto& root: roots)
+    {
+      std::error_code error;
+      if (!std::filesystem::is_directory(root, error))
+      {
+        util::println("Not watching {}, it isn't a directory", root.string());
+        continue;
+      }
+      directories.push_back(root);
+      for (const auto& entry: std::filesystem::recursive_directory_iterator(root, error))
+      {
+        if (entry.is_directory(error))
+        {
+          directories.push_back(entry.path());
+        }
+      }
+    }
+    return directories;
+  }
+} // namespace
+
+FileWatcher::FileWatcher(std::vector<std::filesystem::path> directories) :
+    directories_(std::move(directories)), thread_([this](const std::stop_token& stop_token) { Watch(stop_token); })
+{
+}
+
+std::vector<std::filesystem::path> FileWatcher::TakeChanged()
+{
+  const std::scoped_lock lock(mutex_);
+  return std::exchange(changed_, {});
+}
+
+void FileWatcher::Watch(const std::stop_token& stop_token)
+{
+  TracySetThreadName("File watcher");
+
+  if (!WatchNotify(stop_token))
+  {
+    WatchPoll(stop_token);
+  }
+}
+
+bool FileWatcher::WatchNotify([[maybe_unused]] const std::stop_token& stop_token)
+{
+#ifdef __linux__
+  const int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0)
+  {
+    return false;
+  }
+
+  // editors either write the file in place or write a temporary one and move it over the old one
+  std::unordered_map<int, std::filesystem::path> watches;
+  for (const auto& directory: ListDirectories(directories_))
+  {
+    const int wd = inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (wd >= 0)
+    {
+      watches.emplace(wd, directory);
+    }
+  }
+
+  alignas(inotify_event) std::array<char, 4096> buffer{};
+  pollfd poll_fd{.fd = fd, .events = POLLIN, .revents = 0};
+  while (!stop_token.stop_requested())
+  {
+    if (poll(&poll_fd, 1, static_cast<int>(kWakeInterval.count())) <= 0)
+    {
+      continue;
+    }
+
+    ssize_t length{};
+    while ((length = read(fd, buffer.data(), buffer.size())) > 0)
+    {
+      for (ssize_t offset{}; offset < length;)
+      {
+        const auto* event = reinterpret_cast<const inotify_event*>(buffer.data() + offset);
+        offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+        const auto it = watches.find(event->wd);
+        if (it != watches.end() && event->len > 0 && (event->mask & IN_ISDIR) == 0)
+        {
+          Push(it->second / event->name);
+        }
+      }
+    }
+  }
+
+  close(fd);
+  return true;
+#else
+  return false;
+#endif
+}
+
+void FileWatcher::WatchPoll(const std::stop_token& stop_token)
+{
+  const auto directories = ListDirectories(directories_);
+  std::map<std::filesystem::path, std::filesystem::file_time_type> times;
+  bool first = true;
+  while (!stop_token.stop_requested())
+  {
+    for (const auto& directory: directories)
+    {
+      std::error_code error;
+      for (const auto& entry: std::filesystem::directory_iterator(directory, error))
+      {
+        if (!entry.is_regular_file(error))
+        {
+          continue;
+        }
+
+        const auto time = entry.last_write_time(error);
+        auto [it, inserted] = times.try_emplace(entry.path(), time);
+        // everything is new the first time around, that's not a change
+        if ((inserted && !first) || (!inserted && it->second != time))
+        {
+          it->second = time;
+          Push(entry.path());
+        }
+      }
+    }
+    first = false;
+
+    std::this_thread::sleep_for(kPollInterval);
+  }
+}
+
+void FileWatcher::Push(const std::filesystem::path& path)
+{
+  const std::scoped_lock lock(mutex_);
+  if (std::ranges::find(changed_, path) == changed_.end())
+  {
+    changed_.push_back(path);
+  }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <filesystem>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+// Watches directories and their subdirectories for files that got written, on a thread of its own. Uses inotify on
+// Linux and falls back to comparing modification times everywhere else, or when inotify isn't available.
+class FileWatcher
+{
+public:
+  explicit FileWatcher(std::vector<std::filesystem::path> directories);
+  FileWatcher(const FileWatcher&) = delete;
+  FileWatcher(FileWatcher&&) = delete;
+  FileWatcher& operator=(const FileWatcher&) = delete;
+  FileWatcher& operator=(FileWatcher&&) = delete;
+  ~FileWatcher() = default;
+
+  // Files written since the last call, each one once.
+  [[nodiscard]] std::vector<std::filesystem::path> TakeChanged();
+
+private:
+  void Watch(const std::stop_token& stop_token);
+  // returns false if inotify couldn't be set up
+  bool WatchNotify(const std::stop_token& stop_token);
+  void WatchPoll(const std::stop_token& stop_token);
+  void Push(const std::filesystem::path& path);
+
+  std::vector<std::filesystem::path> directories_;
+
+  std::mutex mutex_;
+  std::vector<std::filesystem::path> changed_;
+
+  // last, so the thread is joined before anything it uses goes away
+  std::jthread thread_;
+};
@@ -0,0 +1,213 @@
+#include "job_system.hpp"
+
+#include <format>
+#include <string>
+
+namespace
+{
+  // index of the worker running on this thread, -1 on threads outside the pool
+  thread_local int32_t tls_worker_index = -1;
+} // namespace
+
+JobSystem::JobSystem(const uint32_t worker_count)
+{
+  queues_.reserve(worker_count);
+  for (uint32_t i{}; i < worker_count; i++)
+  {
+    queues_.push_back(std::make_unique<Queue>());
+  }
+
+  workers_.reserve(worker_count);
+  for (uint32_t i{}; i < worker_count; i++)
+  {
+    workers_.emplace_back([this, i](const std::stop_token& stop_token) { Work(stop_token, i); });
+  }
+}
+
+JobSystem::~JobSystem()
+{
+  // Every submitted job still runs, owners may be waiting for them to be done. This thread helps out, the workers
+  // empty the queues before they exit.
+  while (const auto job = Pop())
+  {
+    Run(job);
+  }
+  for (auto& worker: workers_)
+  {
+    worker.request_stop();
+  }
+  {
+    const std::scoped_lock lock(sleep_mutex_);
+  }
+  wake_.notify_all();
+}
+
+JobHandle JobSystem::Submit(std::function<void()> work, const std::span<const JobHandle> dependencies)
+{
+  auto job = std::make_shared<Job>();
+  job->work_ = std::move(work);
+  job->unfinished_.store(static_cast<uint32_t>(dependencies.size()) + 1, std::memory_order_relaxed);
+
+  for (const auto& dependency: dependencies)
+  {
+    if (dependency)
+    {
+      const std::scoped_lock lock(dependency->mutex_);
+      if (!dependency->done_.load(std::memory_order_relaxed))
+      {
+        dependency->continuations_.push_back(job);
+        continue;
+      }
+    }
+    job->unfinished_.fetch_sub(1, std::memory_order_acq_rel);
+  }
+
+  if (job->unfinished_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+  {
+    Enqueue(job);
+  }
+
+  return job;
+}
+
+void JobSystem::Wait(const JobHandle& job)
+{
+  ZoneScopedN("JobSystem::Wait");
+
+  // a job whose dependencies aren't done isn't queued yet, a worker keeps the pool going until it is
+  const bool is_worker = tls_worker_index >= 0;
+  while (!job->Done())
+  {
+    if (Take(job))
+    {
+      Run(job);
+    } else if (const auto other = is_worker ? Pop() : JobHandle{})
+    {
+      Run(other);
+    } else
+    {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void JobSystem::Enqueue(JobHandle job)
+{
+  // workers keep what they spawn, the rest is dealt out round robin
+  const uint32_t index = tls_worker_index >= 0
+                             ? static_cast<uint32_t>(tls_worker_index)
+                             : next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+  {
+    const auto& queue = queues_.at(index);
+    const std::scoped_lock lock(queue->mutex);
+    queue->jobs.push_back(std::move(job));
+  }
+
+  queued_.fetch_add(1, std::memory_order_release);
+  {
+    // a worker between checking queued_ and going to sleep would miss the notify otherwise
+    const std::scoped_lock lock(sleep_mutex_);
+  }
+  wake_.notify_one();
+}
+
+JobHandle JobSystem::Pop()
+{
+  const auto queue_count = static_cast<uint32_t>(queues_.size());
+  const bool is_worker = tls_worker_index >= 0;
+  const uint32_t own = is_worker ? static_cast<uint32_t>(tls_worker_index) : 0;
+
+  if (is_worker)
+  {
+    const auto& queue = queues_.at(own);
+    const std::scoped_lock lock(queue->mutex);
+    if (!queue->jobs.empty())
+    {
+      auto job = std::move(queue->jobs.back());
+      queue->jobs.pop_back();
+      queued_.fetch_sub(1, std::memory_order_relaxed);
+      return job;
+    }
+  }
+
+  // steal the oldest job, it's the most likely to spawn more work
+  for (uint32_t i = is_worker ? 1 : 0; i < queue_count; i++)
+  {
+    const auto& queue = queues_.at((own + i) % queue_count);
+    const std::scoped_lock lock(queue->mutex);
+    if (!queue->jobs.empty())
+    {
+      auto job = std::move(queue->jobs.front());
+      queue->jobs.pop_front();
+      queued_.fetch_sub(1, std::memory_order_relaxed);
+      return job;
+    }
+  }
+
+  return nullptr;
+}
+
+bool JobSystem::Take(const JobHandle& job)
+{
+  for (const auto& queue: queues_)
+  {
+    const std::scoped_lock lock(queue->mutex);
+    if (const auto it = std::ranges::find(queue->jobs, job); it != queue->jobs.end())
+    {
+      queue->jobs.erase(it);
+      queued_.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+void JobSystem::Run(const JobHandle& job)
+{
+  {
+    ZoneScopedN("JobSystem::Job");
+    job->work_();
+  }
+  // drop the captures now, handles can outlive the job by a lot
+  job->work_ = nullptr;
+
+  std::vector<JobHandle> continuations;
+  {
+    const std::scoped_lock lock(job->mutex_);
+    job->done_.store(true, std::memory_order_release);
+    continuations.swap(job->continuations_);
+  }
+
+  for (auto& continuation: continuations)
+  {
+    if (continuation->unfinished_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+      Enqueue(std::move(continuation));
+    }
+  }
+}
+
+void JobSystem::Work(const std::stop_token& stop_token, const uint32_t index)
+{
+  tls_worker_index = static_cast<int32_t>(index);
+  const std::string name = std::format("Job worker {}", index);
+  TracySetThreadName(name.c_str());
+
+  while (!stop_token.stop_requested())
+  {
+    if (const auto job = Pop())
+    {
+      Run(job);
+      continue;
+    }
+
+    std::unique_lock lock(sleep_mutex_);
+    wake_.wait(lock, stop_token, [this] { return queued_.load(std::memory_order_acquire) > 0; });
+  }
+
+  // what's left, including the continuations of jobs that were still running
+  while (const auto job = Pop())
+  {
+    Run(job);
+  }
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#include "tracy/Tracy.hpp"
+
+// A unit of work for the JobSystem, kept alive by its handles and by the jobs that wait on it.
+class Job
+{
+public:
+  [[nodiscard]] bool Done() const { return done_.load(std::memory_order_acquire); }
+
+private:
+  friend class JobSystem;
+
+  std::function<void()> work_;
+  std::atomic<uint32_t> unfinished_{1}; // dependencies left, plus one held by Submit until it's done wiring them up
+  std::atomic<bool> done_{false};
+  std::mutex mutex_;
+  std::vector<std::shared_ptr<Job>> continuations_; // jobs that depend on this one
+};
+
+using JobHandle = std::shared_ptr<Job>;
+
+// Work stealing scheduler. Every worker owns a deque, it runs its own jobs newest first and steals the oldest jobs of
+// the other workers when it runs dry. Jobs submitted from outside the pool are spread over the deques. A worker waiting
+// on a job runs other jobs in the meantime, so a job can wait on the jobs it spawns without starving the pool. Other
+// threads only help with what they wait on, a frame shouldn't end up running somebody's multi second load.
+// Jobs must not throw. Destroying the system runs whatever is still queued.
+class JobSystem
+{
+public:
+  explicit JobSystem(uint32_t worker_count = DefaultWorkerCount());
+  JobSystem(const JobSystem&) = delete;
+  JobSystem(JobSystem&&) = delete;
+  JobSystem& operator=(const JobSystem&) = delete;
+  JobSystem& operator=(JobSystem&&) = delete;
+  ~JobSystem();
+
+  // Runs work once every dependency is done. Null dependencies are ignored.
+  JobHandle Submit(std::function<void()> work, std::span<const JobHandle> dependencies = {});
+
+  // Returns once the job is done. Runs the job itself if it's still queued, workers run other jobs while they wait.
+  void Wait(const JobHandle& job);
+
+  // Calls fn(begin, end) for batches of [0, count) and returns once all of them are done. The calling thread claims
+  // batches along with the workers and runs nothing else, a count that fits in one batch never leaves it.
+  template<typename F>
+  void ParallelFor(uint32_t count, uint32_t batch_size, F&& fn);
+
+  [[nodiscard]] uint32_t WorkerCount() const { return static_cast<uint32_t>(workers_.size()); }
+
+  // One less than the hardware threads, the main thread is the other one. hardware_concurrency may not know and say 0.
+  [[nodiscard]] static uint32_t DefaultWorkerCount()
+  {
+    const auto n = std::thread::hardware_concurrency();
+    return n > 1 ? n - 1 : 1;
+  }
+
+private:
+  struct Queue
+  {
+    std::mutex mutex;
+    std::deque<JobHandle> jobs;
+  };
+
+  void Enqueue(JobHandle job);
+  [[nodiscard]] JobHandle Pop();
+  [[nodiscard]] bool Take(const JobHandle& job);
+  void Run(const JobHandle& job);
+  void Work(const std::stop_token& stop_token, uint32_t index);
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::atomic<uint32_t> next_queue_{0};
+  std::atomic<uint32_t> queued_{0};
+
+  std::mutex sleep_mutex_;
+  std::condition_variable_any wake_;
+
+  // last, so the workers are joined before anything they use goes away
+  std::vector<std::jthread> workers_;
+};
+
+template<typename F>
+void JobSystem::ParallelFor(const uint32_t count, uint32_t batch_size, F&& fn)
+{
+  batch_size = std::max(batch_size, 1U);
+  if (count <= batch_size)
+  {
+    fn(0U, count);
+    return;
+  }
+
+  ZoneScopedN("JobSystem::ParallelFor");
+
+  // helpers that only get to run after the last batch is claimed return without touching fn, the counters outlive
+  // the call for them
+  struct Batches
+  {
+    std::atomic<uint32_t> next{0};
+    std::atomic<uint32_t> done{0};
+  };
+  const auto batches = std::make_shared<Batches>();
+  const uint32_t batch_count = (count + batch_size - 1) / batch_size;
+  const auto claim = [&fn, batches, count, batch_size, batch_count]
+  {
+    for (uint32_t batch = batches->next.fetch_add(1, std::memory_order_relaxed); batch < batch_count;
+         batch = batches->next.fetch_add(1, std::memory_order_relaxed))
+    {
+      const uint32_t begin = batch * batch_size;
+      fn(begin, std::min(begin + batch_size, count));
+      batches->done.fetch_add(1, std::memory_order_release);
+    }
+  };
+
+  const uint32_t helper_count = std::min(batch_count - 1, WorkerCount());
+  for (uint32_t i{}; i < helper_count; i++)
+  {
+    Submit(claim);
+  }
+
+  claim();
+
+  // the batches left are running on other threads right now
+  while (batches->done.load(std::memory_order_acquire) < batch_count)
+  {
+    std::this_thread::yield();
+  }
+}
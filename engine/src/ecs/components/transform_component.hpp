@@ -1,7 +1,24 @@
 #pragma once
+#include <entt/entt.hpp>
+
 #include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
 
 struct CTransform
 {
   glm::mat4 world;
 };
+
+// Entities with a local transform get their CTransform written by the TransformHierarchy, relative to their parent's
+// world transform if they have a CParent.
+struct CLocalTransform
+{
+  glm::vec3 position{0.0F};
+  glm::quat rotation{1.0F, 0.0F, 0.0F, 0.0F};
+  glm::vec3 scale{1.0F};
+};
+
+struct CParent
+{
+  entt::entity parent = entt::null;
+};
@@ -0,0 +1,182 @@
+#include "render_object_sync.hpp"
+
+#include <span>
+#include <vector>
+
+#include "core/job_system.hpp"
+#include "ecs/components/mesh_component.hpp"
+#include "ecs/components/transform_component.hpp"
+#include "render/vk_renderer.hpp"
+#include "tracy/Tracy.hpp"
+
+namespace
+{
+  constexpr uint32_t kBatchSize = 1024;
+
+  // entity_slots_ markers for entities that don't have a slot to write
+  constexpr uint32_t kSkipped = UINT32_MAX;
+  constexpr uint32_t kPending = UINT32_MAX - 1;
+  constexpr uint32_t kNew = UINT32_MAX - 2;
+} // namespace
+
+RenderObjectSync::RenderObjectSync(entt::registry& registry, VulkanRenderer& renderer, JobSystem& jobs) :
+    registry_(&registry), renderer_(&renderer), jobs_(&jobs)
+{
+  registry.on_construct<CMesh>().connect<&RenderObjectSync::OnChanged>(*this);
+  registry.on_update<CMesh>().connect<&RenderObjectSync::OnChanged>(*this);
+  registry.on_destroy<CMesh>().connect<&RenderObjectSync::OnRemoved>(*this);
+
+  registry.on_construct<CTransform>().connect<&RenderObjectSync::OnChanged>(*this);
+  registry.on_update<CTransform>().connect<&RenderObjectSync::OnChanged>(*this);
+  registry.on_destroy<CTransform>().connect<&RenderObjectSync::OnRemoved>(*this);
+}
+
+RenderObjectSync::~RenderObjectSync()
+{
+  registry_->on_construct<CMesh>().disconnect(*this);
+  registry_->on_update<CMesh>().disconnect(*this);
+  registry_->on_destroy<CMesh>().disconnect(*this);
+
+  registry_->on_construct<CTransform>().disconnect(*this);
+  registry_->on_update<CTransform>().disconnect(*this);
+  registry_->on_destroy<CTransform>().disconnect(*this);
+}
+
+void RenderObjectSync::Update()
+{
+  ZoneScopedN("RenderObjectSync::Update");
+
+  const auto count = static_cast<uint32_t>(dirty_.size());
+  if (count == 0)
+  {
+    return;
+  }
+
+  // only read from here on, the storages are safe to share between the batches
+  const auto& meshes = registry_->storage<CMesh>();
+  const auto& transforms = registry_->storage<CTransform>();
+  const std::span entities(dirty_.data(), count);
+
+  // first pass sorts the entities out and writes the ones that already have a slot
+  entity_slots_.resize(count);
+  jobs_->ParallelFor(count, kBatchSize,
+                     [&](const uint32_t begin, const uint32_t end)
+                     {
+                       for (uint32_t i = begin; i < end; i++)
+                       {
+                         const auto entity = entities[i];
+                         // only one of the two components so far
+                         if (!meshes.contains(entity) || !transforms.contains(entity))
+                         {
+                           entity_slots_[i] = kSkipped;
+                           continue;
+                         }
+
+                         // a failed load never becomes ready, drop the entity until its mesh changes again
+                         const auto& handle = meshes.get(entity).mesh;
+                         if (!handle.valid() || handle.state() == ResourceState::kFailed)
+                         {
+                           entity_slots_[i] = kSkipped;
+                           continue;
+                         }
+
+                         // still streaming in, try again next frame
+                         if (!handle.ready())
+                         {
+                           entity_slots_[i] = kPending;
+                           continue;
+                         }
+
+                         const auto it = slots_.find(entity);
+                         if (it == slots_.end())
+                         {
+                           entity_slots_[i] = kNew;
+                           continue;
+                         }
+
+                         entity_slots_[i] = it->second;
+                         renderer_->WriteObject(it->second, transforms.get(entity).world, handle->renderer_id,
+                                                handle->texture_id);
+                       }
+                     });
+
+  // slots come from the renderer's free list, handing them out has to happen on this thread
+  new_entities_.clear();
+  written_slots_.clear();
+  std::vector<entt::entity> pending;
+  for (uint32_t i{}; i < count; i++)
+  {
+    if (entity_slots_[i] == kPending || entity_slots_[i] == kSkipped)
+    {
+      // the slot may still point at a mesh the entity just let go of, that mesh gets freed
+      if (const auto it = slots_.find(entities[i]); it != slots_.end())
+      {
+        renderer_->DestroyObject(it->second);
+        slots_.erase(it);
+      }
+      if (entity_slots_[i] == kPending)
+      {
+        pending.push_back(entities[i]);
+      }
+    } else if (entity_slots_[i] == kNew)
+    {
+      new_entities_.push_back(i);
+    } else if (entity_slots_[i] != kSkipped)
+    {
+      written_slots_.push_back(entity_slots_[i]);
+    }
+  }
+
+  const auto new_count = static_cast<uint32_t>(new_entities_.size());
+  if (new_count > 0)
+  {
+    const size_t first_new = written_slots_.size();
+    written_slots_.resize(first_new + new_count);
+    const std::span new_slots = std::span(written_slots_).subspan(first_new);
+    renderer_->CreateObjects(new_slots);
+
+    for (uint32_t i{}; i < new_count; i++)
+    {
+      slots_.emplace(entities[new_entities_[i]], new_slots[i]);
+    }
+
+    jobs_->ParallelFor(new_count, kBatchSize,
+                       [&](const uint32_t begin, const uint32_t end)
+                       {
+                         for (uint32_t i = begin; i < end; i++)
+                         {
+                           const auto entity = entities[new_entities_[i]];
+                           const auto& handle = meshes.get(entity).mesh;
+                           renderer_->WriteObject(new_slots[i], transforms.get(entity).world, handle->renderer_id,
+                                                  handle->texture_id);
+                         }
+                       });
+  }
+
+  renderer_->CommitObjects(written_slots_);
+
+  dirty_.clear();
+  for (const auto entity: pending)
+  {
+    dirty_.push(entity);
+  }
+}
+
+void RenderObjectSync::OnChanged(entt::registry& /*registry*/, const entt::entity entity)
+{
+  if (!dirty_.contains(entity))
+  {
+    dirty_.push(entity);
+  }
+}
+
+void RenderObjectSync::OnRemoved(entt::registry& /*registry*/, const entt::entity entity)
+{
+  dirty_.remove(entity);
+
+  if (const auto it = slots_.find(entity); it != slots_.end())
+  {
+    renderer_->DestroyObject(it->second);
+    slots_.erase(it);
+  }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <entt/entt.hpp>
+#include <unordered_map>
+#include <vector>
+
+class VulkanRenderer;
+class JobSystem;
+
+// Mirrors entities with a CMesh and a CTransform into the renderer's object table. Listens to the registry's signals
+// so only entities whose components changed are touched, a static scene costs nothing per frame. Changes have to go
+// through the registry (emplace, replace, patch) to be seen, writing through a component reference doesn't fire a
+// signal.
+// Changed entities are extracted on the job system in batches that write straight into the renderer's object slots.
+class RenderObjectSync
+{
+public:
+  RenderObjectSync(entt::registry& registry, VulkanRenderer& renderer, JobSystem& jobs);
+  RenderObjectSync(const RenderObjectSync&) = delete;
+  RenderObjectSync(RenderObjectSync&&) = delete;
+  RenderObjectSync& operator=(const RenderObjectSync&) = delete;
+  RenderObjectSync& operator=(RenderObjectSync&&) = delete;
+  ~RenderObjectSync();
+
+  // Hands the entities that changed since the last call to the renderer. Entities whose mesh is still loading stay
+  // queued until it's ready.
+  void Update();
+
+private:
+  void OnChanged(entt::registry& registry, entt::entity entity);
+  void OnRemoved(entt::registry& registry, entt::entity entity);
+
+  entt::registry* registry_;
+  VulkanRenderer* renderer_;
+  JobSystem* jobs_;
+
+  std::unordered_map<entt::entity, uint32_t> slots_;
+  entt::sparse_set dirty_; // a set, an entity patched a few times in a frame is still written once
+
+  // per dirty entity, reused across frames
+  std::vector<uint32_t> entity_slots_;
+  std::vector<uint32_t> new_entities_; // indices into the dirty entities
+  std::vector<uint32_t> written_slots_;
+};
@@ -0,0 +1,289 @@
+#include "transform_hierarchy.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+#include "core/job_system.hpp"
+#include "ecs/components/transform_component.hpp"
+#include "tracy/Tracy.hpp"
+
+namespace
+{
+  constexpr uint32_t kNoParent = UINT32_MAX;
+  constexpr uint32_t kBatchSize = 1024;
+
+  glm::mat4 Compose(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+  {
+    glm::mat4 local = glm::mat4_cast(rotation);
+    local[0] *= scale.x;
+    local[1] *= scale.y;
+    local[2] *= scale.z;
+    local[3] = glm::vec4(position, 1.0F);
+    return local;
+  }
+} // namespace
+
+TransformHierarchy::TransformHierarchy(entt::registry& registry, JobSystem& jobs) : registry_(&registry), jobs_(&jobs)
+{
+  registry.on_construct<CLocalTransform>().connect<&TransformHierarchy::OnStructureChanged>(*this);
+  registry.on_update<CLocalTransform>().connect<&TransformHierarchy::OnLocalChanged>(*this);
+  registry.on_destroy<CLocalTransform>().connect<&TransformHierarchy::OnStructureChanged>(*this);
+
+  registry.on_construct<CParent>().connect<&TransformHierarchy::OnStructureChanged>(*this);
+  registry.on_update<CParent>().connect<&TransformHierarchy::OnStructureChanged>(*this);
+  registry.on_destroy<CParent>().connect<&TransformHierarchy::OnStructureChanged>(*this);
+}
+
+TransformHierarchy::~TransformHierarchy()
+{
+  registry_->on_construct<CLocalTransform>().disconnect(*this);
+  registry_->on_update<CLocalTransform>().disconnect(*this);
+  registry_->on_destroy<CLocalTransform>().disconnect(*this);
+
+  registry_->on_construct<CParent>().disconnect(*this);
+  registry_->on_update<CParent>().disconnect(*this);
+  registry_->on_destroy<CParent>().disconnect(*this);
+}
+
+void TransformHierarchy::Update()
+{
+  ZoneScopedN("TransformHierarchy::Update");
+
+  if (structure_dirty_)
+  {
+    Rebuild();
+  }
+
+  if (first_dirty_level_ == UINT32_MAX)
+  {
+    return;
+  }
+
+  // a level only reads the level above it, the batches within a level write disjoint nodes
+  uint32_t level = first_dirty_level_;
+  for (; level < LevelCount(); level++)
+  {
+    const uint32_t begin = level_offsets_[level];
+    const uint32_t count = level_offsets_[level + 1] - begin;
+    std::atomic<uint32_t> dirty_count{0};
+
+    jobs_->ParallelFor(count, kBatchSize,
+                       [&](const uint32_t batch_begin, const uint32_t batch_end)
+                       {
+                         uint32_t batch_dirty{};
+                         for (uint32_t i = begin + batch_begin; i < begin + batch_end; i++)
+                         {
+                           const uint32_t parent = parents_[i];
+                           if (dirty_[i] == 0 && (parent == kNoParent || dirty_[parent] == 0))
+                           {
+                             continue;
+                           }
+
+                           const glm::mat4 local = Compose(positions_[i], rotations_[i], scales_[i]);
+                           worlds_[i] = parent == kNoParent ? local : worlds_[parent] * local;
+                           dirty_[i] = 1;
+                           batch_dirty++;
+                         }
+                         dirty_count.fetch_add(batch_dirty, std::memory_order_relaxed);
+                       });
+
+    // nothing changed in this level and nothing below it was touched directly, the rest of the tree is up to date
+    if (dirty_count.load(std::memory_order_relaxed) == 0 && level >= last_dirty_level_)
+    {
+      break;
+    }
+  }
+
+  // signals fire on the write, so this part stays on the calling thread
+  const uint32_t end = level_offsets_[std::min(level + 1, LevelCount())];
+  for (uint32_t i = level_offsets_[first_dirty_level_]; i < end; i++)
+  {
+    if (dirty_[i] != 0)
+    {
+      registry_->emplace_or_replace<CTransform>(entities_[i], worlds_[i]);
+      dirty_[i] = 0;
+    }
+  }
+
+  first_dirty_level_ = UINT32_MAX;
+  last_dirty_level_ = 0;
+}
+
+void TransformHierarchy::OnLocalChanged(entt::registry& registry, const entt::entity entity)
+{
+  // picked up by the rebuild
+  if (structure_dirty_)
+  {
+    return;
+  }
+
+  const uint32_t node = nodes_.at(entity);
+  const auto& local = registry.get<CLocalTransform>(entity);
+  positions_[node] = local.position;
+  rotations_[node] = local.rotation;
+  scales_[node] = local.scale;
+  dirty_[node] = 1;
+
+  const uint32_t level = LevelOf(node);
+  first_dirty_level_ = std::min(first_dirty_level_, level);
+  last_dirty_level_ = std::max(last_dirty_level_, level);
+}
+
+void TransformHierarchy::OnStructureChanged(entt::registry& /*registry*/, const entt::entity /*entity*/)
+{
+  structure_dirty_ = true;
+}
+
+void TransformHierarchy::Rebuild()
+{
+  ZoneScopedN("TransformHierarchy::Rebuild");
+
+  structure_dirty_ = false;
+
+  const auto view = registry_->view<CLocalTransform>();
+  std::vector<entt::entity> entities(view.begin(), view.end());
+  const auto count = static_cast<uint32_t>(entities.size());
+
+  std::unordered_map<entt::entity, uint32_t> unsorted;
+  unsorted.reserve(count);
+  for (uint32_t i{}; i < count; i++)
+  {
+    unsorted.emplace(entities[i], i);
+  }
+
+  // parents without a local transform, dead parents and cycles all make the node a root
+  std::vector<uint32_t> parents(count, kNoParent);
+  for (uint32_t i{}; i < count; i++)
+  {
+    if (const auto* link = registry_->try_get<CParent>(entities[i]))
+    {
+      if (const auto it = unsorted.find(link->parent); it != unsorted.end() && it->second != i)
+      {
+        parents[i] = it->second;
+      }
+    }
+  }
+
+  constexpr uint32_t kUnknown = UINT32_MAX;
+  constexpr uint32_t kVisiting = UINT32_MAX - 1;
+  std::vector<uint32_t> depths(count, kUnknown);
+  std::vector<uint32_t> chain;
+  for (uint32_t i{}; i < count; i++)
+  {
+    // walk up to the first node with a known depth, then hand out depths on the way back down
+    uint32_t node = i;
+    while (true)
+    {
+      while (node != kNoParent && depths[node] == kUnknown)
+      {
+        depths[node] = kVisiting;
+        chain.push_back(node);
+        node = parents[node];
+      }
+      if (node == kNoParent || depths[node] != kVisiting)
+      {
+        break;
+      }
+
+      // ran into the chain itself, cut the loop there and walk again
+      parents[node] = kNoParent;
+      for (const auto visited: chain)
+      {
+        depths[visited] = kUnknown;
+      }
+      chain.clear();
+      node = i;
+    }
+
+    uint32_t depth = node == kNoParent ? 0 : depths[node] + 1;
+    while (!chain.empty())
+    {
+      depths[chain.back()] = depth++;
+      chain.pop_back();
+    }
+  }
+
+  // counting sort by depth, keeps the view order within a level
+  const uint32_t level_count = count == 0 ? 0 : *std::ranges::max_element(depths) + 1;
+  level_offsets_.assign(level_count + 1, 0);
+  for (const auto depth: depths)
+  {
+    level_offsets_[depth + 1]++;
+  }
+  for (uint32_t level{}; level < level_count; level++)
+  {
+    level_offsets_[level + 1] += level_offsets_[level];
+  }
+
+  std::vector<uint32_t> sorted(count);
+  {
+    std::vector<uint32_t> cursors(level_offsets_.begin(), level_offsets_.end() - 1);
+    for (uint32_t i{}; i < count; i++)
+    {
+      sorted[i] = cursors[depths[i]]++;
+    }
+  }
+
+  // the old nodes by entity, whatever kept its parent and local transform keeps its world and dirty flag
+  const auto old_nodes = std::exchange(nodes_, {});
+  const auto old_entities = std::exchange(entities_, {});
+  const auto old_parents = std::exchange(parents_, {});
+  const auto old_positions = std::exchange(positions_, {});
+  const auto old_rotations = std::exchange(rotations_, {});
+  const auto old_scales = std::exchange(scales_, {});
+  const auto old_worlds = std::exchange(worlds_, {});
+  const auto old_dirty = std::exchange(dirty_, {});
+
+  entities_.resize(count);
+  parents_.resize(count);
+  positions_.resize(count);
+  rotations_.resize(count);
+  scales_.resize(count);
+  worlds_.resize(count);
+  dirty_.assign(count, 0);
+  nodes_.reserve(count);
+  for (uint32_t i{}; i < count; i++)
+  {
+    const uint32_t node = sorted[i];
+    const auto& local = view.get<CLocalTransform>(entities[i]);
+    entities_[node] = entities[i];
+    parents_[node] = parents[i] == kNoParent ? kNoParent : sorted[parents[i]];
+    positions_[node] = local.position;
+    rotations_[node] = local.rotation;
+    scales_[node] = local.scale;
+    nodes_.emplace(entities[i], node);
+
+    // local changes aren't tracked while the structure is dirty, so they're compared here. The update dirties the
+    // subtrees below the nodes set here.
+    const auto old = old_nodes.find(entities[i]);
+    if (old == old_nodes.end())
+    {
+      dirty_[node] = 1;
+      continue;
+    }
+    const uint32_t o = old->second;
+    const entt::entity parent = parents[i] == kNoParent ? entt::null : entities[parents[i]];
+    const entt::entity old_parent = old_parents[o] == kNoParent ? entt::null : old_entities[old_parents[o]];
+    worlds_[node] = old_worlds[o];
+    const bool moved = local.position != old_positions[o] || local.rotation != old_rotations[o] ||
+                       local.scale != old_scales[o];
+    dirty_[node] = old_dirty[o] != 0 || parent != old_parent || moved ? 1 : 0;
+  }
+
+  first_dirty_level_ = UINT32_MAX;
+  last_dirty_level_ = 0;
+  const auto first = std::ranges::find(dirty_, 1);
+  if (first != dirty_.end())
+  {
+    const auto last = std::ranges::find(dirty_.rbegin(), dirty_.rend(), 1);
+    first_dirty_level_ = LevelOf(static_cast<uint32_t>(first - dirty_.begin()));
+    last_dirty_level_ = LevelOf(static_cast<uint32_t>(dirty_.rend() - last) - 1);
+  }
+}
+
+uint32_t TransformHierarchy::LevelOf(const uint32_t node) const
+{
+  const auto it = std::ranges::upper_bound(level_offsets_, node);
+  return static_cast<uint32_t>(it - level_offsets_.begin()) - 1;
+}
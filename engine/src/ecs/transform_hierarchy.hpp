@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <entt/entt.hpp>
+#include <unordered_map>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+class JobSystem;
+
+// Computes CTransform::world for entities with a CLocalTransform, parented through CParent. The nodes are kept in
+// struct of arrays sorted by depth, so every level only reads the finished level above it and is updated in parallel.
+// Like the RenderObjectSync it listens to the registry's signals: a changed local transform dirties its node, and the
+// update only walks the levels from the first dirty one down, recomputing the dirty subtrees. Adding, removing or
+// reparenting nodes re-sorts everything on the next update, but only the new and reparented subtrees are recomputed.
+class TransformHierarchy
+{
+public:
+  TransformHierarchy(entt::registry& registry, JobSystem& jobs);
+  TransformHierarchy(const TransformHierarchy&) = delete;
+  TransformHierarchy(TransformHierarchy&&) = delete;
+  TransformHierarchy& operator=(const TransformHierarchy&) = delete;
+  TransformHierarchy& operator=(TransformHierarchy&&) = delete;
+  ~TransformHierarchy();
+
+  // Writes the world transforms of the nodes that changed since the last call, before the RenderObjectSync runs.
+  void Update();
+
+  [[nodiscard]] uint32_t NodeCount() const { return static_cast<uint32_t>(entities_.size()); }
+  [[nodiscard]] uint32_t LevelCount() const { return static_cast<uint32_t>(level_offsets_.size()) - 1; }
+
+private:
+  void OnLocalChanged(entt::registry& registry, entt::entity entity);
+  void OnStructureChanged(entt::registry& registry, entt::entity entity);
+
+  void Rebuild();
+  [[nodiscard]] uint32_t LevelOf(uint32_t node) const;
+
+  entt::registry* registry_;
+  JobSystem* jobs_;
+
+  // one entry per node, sorted by depth
+  std::vector<entt::entity> entities_;
+  std::vector<uint32_t> parents_; // node index, kNoParent for roots
+  std::vector<glm::vec3> positions_;
+  std::vector<glm::quat> rotations_;
+  std::vector<glm::vec3> scales_;
+  std::vector<glm::mat4> worlds_;
+  std::vector<uint8_t> dirty_; // bytes, batches set their own flags concurrently
+
+  // level l holds the nodes [level_offsets_[l], level_offsets_[l + 1])
+  std::vector<uint32_t> level_offsets_{0};
+  std::unordered_map<entt::entity, uint32_t> nodes_;
+
+  // levels holding nodes that were dirtied directly, everything outside of them is only dirtied through a parent
+  uint32_t first_dirty_level_ = UINT32_MAX;
+  uint32_t last_dirty_level_ = 0;
+  bool structure_dirty_ = false;
+};
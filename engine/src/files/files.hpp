@@ -1,13 +1,21 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <optional>
+#include <span>
+#include <utility>
 #include <vector>
 
 #ifdef _WIN32
 #include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 namespace fs = std::filesystem;
@@ -76,4 +84,120 @@ namespace files
 
     return buffer;
   }
+
+  // Read only view of a whole file mapped into memory. Empty if the file couldn't be opened.
+  class MappedFile
+  {
+  public:
+    MappedFile() = default;
+
+    explicit MappedFile(const std::string& path)
+    {
+#if defined(_WIN32)
+      file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                          FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+      if (file_ == INVALID_HANDLE_VALUE)
+      {
+        return;
+      }
+
+      LARGE_INTEGER size{};
+      if (GetFileSizeEx(file_, &size) == 0 || size.QuadPart == 0)
+      {
+        return;
+      }
+
+      mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (mapping_ == nullptr)
+      {
+        return;
+      }
+
+      data_ = static_cast<const std::byte*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+      if (data_ != nullptr)
+      {
+        size_ = static_cast<size_t>(size.QuadPart);
+      }
+#else
+      const int fd = open(path.c_str(), O_RDONLY);
+      if (fd < 0)
+      {
+        return;
+      }
+
+      struct stat info{};
+      if (fstat(fd, &info) == 0 && info.st_size > 0)
+      {
+        void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED)
+        {
+          // we read it front to back once, let the kernel read ahead
+          madvise(data, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+          data_ = static_cast<const std::byte*>(data);
+          size_ = static_cast<size_t>(info.st_size);
+        }
+      }
+      // the mapping keeps its own reference to the file
+      close(fd);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept { swap(other); }
+    MappedFile& operator=(MappedFile&& other) noexcept
+    {
+      if (this != &other)
+      {
+        MappedFile(std::move(other)).swap(*this);
+      }
+      return *this;
+    }
+
+    ~MappedFile()
+    {
+#if defined(_WIN32)
+      if (data_ != nullptr)
+      {
+        UnmapViewOfFile(data_);
+      }
+      if (mapping_ != nullptr)
+      {
+        CloseHandle(mapping_);
+      }
+      if (file_ != INVALID_HANDLE_VALUE)
+      {
+        CloseHandle(file_);
+      }
+#else
+      if (data_ != nullptr)
+      {
+        munmap(const_cast<std::byte*>(data_), size_);
+      }
+#endif
+    }
+
+    [[nodiscard]] std::span<const std::byte> data() const { return {data_, size_}; }
+    [[nodiscard]] bool valid() const { return data_ != nullptr; }
+    explicit operator bool() const { return valid(); }
+
+  private:
+    void swap(MappedFile& other) noexcept
+    {
+      std::swap(data_, other.data_);
+      std::swap(size_, other.size_);
+#if defined(_WIN32)
+      std::swap(file_, other.file_);
+      std::swap(mapping_, other.mapping_);
+#endif
+    }
+
+    const std::byte* data_ = nullptr;
+    size_t size_ = 0;
+#if defined(_WIN32)
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+#endif
+  };
 } // namespace files
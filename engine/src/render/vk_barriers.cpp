@@ -145,5 +145,12 @@ vulkan_barriers::StageAccess vulkan_barriers::BufferUsage(const BufferUsageBit u
     access |= vk::AccessFlagBits2::eTransferWrite;
   }
 
+  if ((usage & BufferUsageBit::HostRead) != BufferUsageBit::None)
+  {
+    stage |= vk::PipelineStageFlagBits2::eHost;
+
+    access |= vk::AccessFlagBits2::eHostRead;
+  }
+
   return {.stage = stage, .access = access};
 }
@@ -41,6 +41,8 @@ namespace vulkan_barriers
     CopySource = 1 << 8,
     CopyDestination = 1 << 9,
 
+    HostRead = 1 << 10,
+
     // Derived
     AllR = RGeometry | RFragment | RCompute,
     AllRW = RWGeometry | RWFragment | RWCompute,
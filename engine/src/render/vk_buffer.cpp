@@ -98,6 +98,13 @@ void* VulkanBuffer::map()
 
 void VulkanBuffer::unmap() const { vmaUnmapMemory(allocator_, allocation_); }
 
+void VulkanBuffer::Invalidate() const { VK_CHECK(vmaInvalidateAllocation(allocator_, allocation_, 0, VK_WHOLE_SIZE)); }
+
+void VulkanBuffer::Flush(const vk::DeviceSize offset, const vk::DeviceSize range_size) const
+{
+  VK_CHECK(vmaFlushAllocation(allocator_, allocation_, offset, range_size));
+}
+
 void VulkanBuffer::Destroy()
 {
   vmaDestroyBuffer(allocator_, buffer_, allocation_);
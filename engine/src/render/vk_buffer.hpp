@@ -30,6 +30,10 @@ public:
 
   void* map();
   void unmap() const;
+  // Makes gpu writes visible to the mapping, needed before reading memory that isn't host coherent.
+  void Invalidate() const;
+  // Makes cpu writes to the mapping visible to the gpu, needed after writing memory that isn't host coherent.
+  void Flush(vk::DeviceSize offset, vk::DeviceSize range_size) const;
 
   [[nodiscard]] void* GetMappedData() const { return mapped_data_; };
   template<typename T>
@@ -1,5 +1,6 @@
 #include "render/vk_device.hpp"
 
+#include <algorithm>
 #include <set>
 
 #include "util/print.hpp"
@@ -26,17 +27,21 @@ void VulkanDevice::PickPhysicalDevice(vk::Instance instance, vk::SurfaceKHR surf
 
   for (const auto& device: devices)
   {
-    vk::PhysicalDeviceProperties properties{};
+    vk::PhysicalDeviceVulkan12Properties properties12{};
+    vk::PhysicalDeviceProperties2 properties2{.pNext = &properties12};
     vk::PhysicalDeviceVulkan13Features features13{};
     vk::PhysicalDeviceVulkan12Features features12{.pNext = &features13};
     vk::PhysicalDeviceVulkan11Features features11{.pNext = &features12};
     vk::PhysicalDeviceFeatures2 features{.pNext = &features11};
-    device.getProperties(&properties);
+    device.getProperties2(&properties2);
     device.getFeatures2(&features);
+    const auto& properties = properties2.properties;
     if (IsDeviceSuitable(properties))
     {
       physical_device_ = device;
       properties_ = properties;
+      properties12_ = properties12;
+      properties12_.pNext = nullptr;
       available_features_ = features;
       available_features12_ = features12;
       available_features11_ = features11;
@@ -83,6 +88,7 @@ void VulkanDevice::CreateDevice()
 
   enabled_features_.features.multiDrawIndirect = available_features_.features.multiDrawIndirect;
   enabled_features_.features.geometryShader = available_features_.features.geometryShader;
+  enabled_features_.features.textureCompressionBC = available_features_.features.textureCompressionBC;
 
   enabled_features11_.shaderDrawParameters = available_features11_.shaderDrawParameters;
 
@@ -103,10 +109,14 @@ void VulkanDevice::CreateDevice()
   enabled_features12_.descriptorBindingVariableDescriptorCount =
       available_features12_.descriptorBindingVariableDescriptorCount;
 
+  enabled_features12_.shaderSampledImageArrayNonUniformIndexing =
+      available_features12_.shaderSampledImageArrayNonUniformIndexing;
   enabled_features12_.runtimeDescriptorArray = available_features12_.runtimeDescriptorArray;
   enabled_features12_.bufferDeviceAddress = available_features12_.bufferDeviceAddress;
 
+  enabled_features12_.timelineSemaphore = available_features12_.timelineSemaphore;
   enabled_features12_.drawIndirectCount = available_features12_.drawIndirectCount;
+  enabled_features12_.samplerFilterMinmax = available_features12_.samplerFilterMinmax;
   vk::DeviceCreateInfo device_create_info{};
   device_create_info.pNext = &enabled_features_;
   device_create_info.queueCreateInfoCount = static_cast<uint32_t>(queue_create_infos.size());
@@ -192,3 +202,12 @@ bool VulkanDevice::FindQueueFamilies(const vk::SurfaceKHR surface)
 
   return queue_family_indices_.IsComplete();
 }
+
+uint32_t VulkanDevice::MaxUpdateAfterBindTextures() const
+{
+  return std::min({properties12_.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                   properties12_.maxPerStageDescriptorUpdateAfterBindSamplers,
+                   properties12_.maxDescriptorSetUpdateAfterBindSampledImages,
+                   properties12_.maxDescriptorSetUpdateAfterBindSamplers,
+                   properties12_.maxUpdateAfterBindDescriptorsInAllPools});
+}
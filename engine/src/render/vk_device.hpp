@@ -42,11 +42,15 @@ public:
   {
     return queue_family_indices_.compute.value() != queue_family_indices_.graphics.value();
   }
+  [[nodiscard]] bool SupportsBlockCompression() const { return enabled_features_.features.textureCompressionBC != 0; }
+  // Most combined image samplers a single update after bind binding can hold.
+  [[nodiscard]] uint32_t MaxUpdateAfterBindTextures() const;
 
 private:
   vk::PhysicalDevice physical_device_;
   vk::Device device_;
   vk::PhysicalDeviceProperties properties_;
+  vk::PhysicalDeviceVulkan12Properties properties12_;
 
   vk::PhysicalDeviceFeatures2 available_features_;
   vk::PhysicalDeviceVulkan11Features available_features11_;
@@ -1,6 +1,10 @@
 
 #include "render/vk_frame.hpp"
 
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
 #include "render/vk_command_pool.hpp"
 #include "render/vk_descriptor.hpp"
 #include "render/vk_device.hpp"
@@ -9,10 +13,6 @@
 #include "vk_image.hpp"
 #include "vk_renderer.hpp"
 
-constexpr uint32_t kMaxIndirectCommands = 65536;
-constexpr uint32_t kMaxLines = 10000;
-constexpr uint32_t kMaxObjects = 16384;
-
 VulkanFrame::VulkanFrame(const VulkanCommandPool* graphics_pool, /*const VulkanCommandPool* compute_pool,*/
                          const VulkanDescriptorPool* descriptor_pool,
                          const VulkanDescriptorSetLayout* descriptor_layout, VulkanDevice* device,
@@ -31,54 +31,192 @@ VulkanFrame::VulkanFrame(const VulkanCommandPool* graphics_pool, /*const VulkanC
   graphics_cmd_ = graphics_pool->allocate();
   // compute_cmd_ = compute_pool->allocate();
 
-  // Create render object buffer
-  object_buffer_ = std::make_unique<VulkanBuffer>(
+  // Create draw count buffer, one count per culling phase
+  draw_count_ = std::make_unique<VulkanBuffer>(
+      BufferInfo{.size = sizeof(uint32_t) * kCullPhaseCount,
+                 .usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst |
+                          vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eIndirectBuffer,
+                 .memoryUsage = VMA_MEMORY_USAGE_GPU_ONLY,
+                 .memoryFlags = {}},
+      allocator->get(), device_);
+
+  // one VkDispatchIndirectCommand per phase for the cluster stage
+  cluster_dispatch_ = std::make_unique<VulkanBuffer>(
+      BufferInfo{.size = sizeof(vk::DispatchIndirectCommand) * kCullPhaseCount,
+                 .usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst |
+                          vk::BufferUsageFlagBits::eIndirectBuffer,
+                 .memoryUsage = VMA_MEMORY_USAGE_GPU_ONLY,
+                 .memoryFlags = {}},
+      allocator->get(), device_);
+
+  cull_data_buffer_ = std::make_unique<VulkanBuffer>(
       BufferInfo{
-          .size = sizeof(RenderObject) * kMaxObjects,
-          .usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+          .size = sizeof(CullData),
+          .usage = vk::BufferUsageFlagBits::eStorageBuffer,
           .memoryUsage = VMA_MEMORY_USAGE_AUTO,
-          .memoryFlags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT
+          .memoryFlags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT},
+      allocator->get(), device_);
+  cull_data_buffer_->map();
 
-      },
+  // per phase, an instance count and then an instance offset per mesh info
+  mesh_instance_buffer_ = std::make_unique<VulkanBuffer>(
+      BufferInfo{.size = sizeof(uint32_t) * 2 * kMaxMeshInfos * kCullPhaseCount,
+                 .usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                 .memoryUsage = VMA_MEMORY_USAGE_GPU_ONLY,
+                 .memoryFlags = {}},
       allocator->get(), device_);
-  object_buffer_->map();
+
+  // what the culling shaders asked for, read back once the frame's fence is signaled
+  draw_count_readback_ = std::make_unique<VulkanBuffer>(
+      BufferInfo{.size = sizeof(uint32_t) * kCullPhaseCount,
+                 .usage = vk::BufferUsageFlagBits::eTransferDst,
+                 .memoryUsage = VMA_MEMORY_USAGE_AUTO,
+                 .memoryFlags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT},
+      allocator->get(), device_);
+  std::memset(draw_count_readback_->map(), 0, sizeof(uint32_t) * kCullPhaseCount);
+
+  EnsureObjectCapacity(kInitialObjectCapacity);
+  EnsureDrawCapacity(kInitialDrawCapacity);
+  EnsureObjectUpdateCapacity(kInitialObjectUpdateCapacity);
+  EnsureLineCapacity(kInitialLineCapacity);
+  EnsureTextureFeedbackCapacity(kInitialTextureFeedbackCapacity);
+
+  // Allocate descriptor set with per frame descriptor set layout
+  descriptor_set_ = descriptor_pool->allocate(descriptor_layout->get());
+}
+
+VulkanFrame::~VulkanFrame()
+{
+  object_update_buffer_->unmap();
+  debug_line_vertex_buffer_->unmap();
+  cull_data_buffer_->unmap();
+  draw_count_readback_->unmap();
+  texture_feedback_readback_->unmap();
+}
+
+bool VulkanFrame::EnsureObjectCapacity(const uint32_t object_count)
+{
+  if (object_count <= object_capacity_)
+  {
+    return false;
+  }
+  object_capacity_ = std::max(object_count, object_capacity_ * 2);
+
+  // (object index, lod) per visible object, per phase
+  visible_object_buffer_ = std::make_unique<VulkanBuffer>(
+      BufferInfo{.size = sizeof(uint32_t) * 2 * object_capacity_ * kCullPhaseCount,
+                 .usage = vk::BufferUsageFlagBits::eStorageBuffer,
+                 .memoryUsage = VMA_MEMORY_USAGE_GPU_ONLY,
+                 .memoryFlags = {}},
+      allocator_->get(), device_);
+  return true;
+}
+
+bool VulkanFrame::EnsureDrawCapacity(const uint32_t draws_per_phase)
+{
+  if (draws_per_phase <= draw_capacity_)
+  {
+    return false;
+  }
+  draw_capacity_ = std::max(draws_per_phase, draw_capacity_ * 2);
 
   indirect_buffer_ = std::make_unique<VulkanBuffer>(
-      BufferInfo{.size = sizeof(vk::DrawIndexedIndirectCommand) * kMaxIndirectCommands,
+      BufferInfo{.size = sizeof(vk::DrawIndexedIndirectCommand) * draw_capacity_ * kCullPhaseCount,
                  .usage = vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst |
                           vk::BufferUsageFlagBits::eStorageBuffer,
                  .memoryUsage = VMA_MEMORY_USAGE_GPU_ONLY,
                  .memoryFlags = {}},
-      allocator->get(), device_);
+      allocator_->get(), device_);
+
+  draw_item_buffer_ = std::make_unique<VulkanBuffer>(
+      BufferInfo{.size = sizeof(DrawItem) * draw_capacity_ * kCullPhaseCount,
+                 .usage = vk::BufferUsageFlagBits::eStorageBuffer,
+                 .memoryUsage = VMA_MEMORY_USAGE_GPU_ONLY,
+                 .memoryFlags = {}},
+      allocator_->get(), device_);
+  return true;
+}
+
+bool VulkanFrame::EnsureObjectUpdateCapacity(uint32_t update_count)
+{
+  update_count = std::min(update_count, kMaxObjectUpdates);
+  if (update_count <= object_update_capacity_)
+  {
+    return false;
+  }
+  object_update_capacity_ = std::min(std::max(update_count, object_update_capacity_ * 2), kMaxObjectUpdates);
+
+  if (object_update_buffer_)
+  {
+    object_update_buffer_->unmap();
+  }
+  // the changed slots of the renderer's object table
+  object_update_buffer_ = std::make_unique<VulkanBuffer>(
+      BufferInfo{
+          .size = sizeof(ObjectUpdate) * object_update_capacity_,
+          .usage = vk::BufferUsageFlagBits::eStorageBuffer,
+          .memoryUsage = VMA_MEMORY_USAGE_AUTO,
+          .memoryFlags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT},
+      allocator_->get(), device_);
+  object_update_buffer_->map();
+  return true;
+}
+
+bool VulkanFrame::EnsureLineCapacity(const uint32_t line_count)
+{
+  if (line_count <= line_capacity_)
+  {
+    return false;
+  }
+  line_capacity_ = std::max(line_count, line_capacity_ * 2);
 
-  // Create debug line vertex buffer
+  if (debug_line_vertex_buffer_)
+  {
+    debug_line_vertex_buffer_->unmap();
+  }
   debug_line_vertex_buffer_ =
-      std::make_unique<VulkanBuffer>(BufferInfo{.size = sizeof(DebugLineVertex) * 2 * kMaxLines,
+      std::make_unique<VulkanBuffer>(BufferInfo{.size = sizeof(DebugLineVertex) * 2 * line_capacity_,
                                                 .usage = vk::BufferUsageFlagBits::eVertexBuffer,
                                                 .memoryUsage = VMA_MEMORY_USAGE_AUTO,
                                                 .memoryFlags = VMA_ALLOCATION_CREATE_MAPPED_BIT |
                                                                VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT},
-                                     allocator->get(), device_);
+                                     allocator_->get(), device_);
   debug_line_vertex_buffer_->map();
+  return true;
+}
 
-  // Create draw count buffer
-  draw_count_ = std::make_unique<VulkanBuffer>(
-      BufferInfo{.size = sizeof(uint32_t),
+bool VulkanFrame::EnsureTextureFeedbackCapacity(const uint32_t texture_count)
+{
+  if (texture_count <= texture_feedback_capacity_)
+  {
+    return false;
+  }
+  texture_feedback_capacity_ = std::max(texture_count, texture_feedback_capacity_ * 2);
+
+  // one requested mip per texture, see VulkanTextureStreamer
+  texture_feedback_ = std::make_unique<VulkanBuffer>(
+      BufferInfo{.size = sizeof(uint32_t) * texture_feedback_capacity_,
                  .usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst |
-                          vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eIndirectBuffer,
+                          vk::BufferUsageFlagBits::eTransferSrc,
                  .memoryUsage = VMA_MEMORY_USAGE_GPU_ONLY,
                  .memoryFlags = {}},
-      allocator->get(), device_);
+      allocator_->get(), device_);
 
-  // Allocate descriptor set with per frame descriptor set layout
-  descriptor_set_ = descriptor_pool->allocate(descriptor_layout->get());
+  if (texture_feedback_readback_)
+  {
+    texture_feedback_readback_->unmap();
+  }
+  texture_feedback_readback_ = std::make_unique<VulkanBuffer>(
+      BufferInfo{.size = sizeof(uint32_t) * texture_feedback_capacity_,
+                 .usage = vk::BufferUsageFlagBits::eTransferDst,
+                 .memoryUsage = VMA_MEMORY_USAGE_AUTO,
+                 .memoryFlags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT},
+      allocator_->get(), device_);
+  // nothing seen until the frame ran once
+  std::memset(texture_feedback_readback_->map(), 0xFF, sizeof(uint32_t) * texture_feedback_capacity_);
+  return true;
 }
 
-VulkanFrame::~VulkanFrame()
-{
-  object_buffer_->unmap();
-  debug_line_vertex_buffer_->unmap();
-}
 void VulkanFrame::RecreateFrameImages(const uint32_t width, const uint32_t height)
 {
   depth_image_ = nullptr;
@@ -87,7 +225,7 @@ void VulkanFrame::RecreateFrameImages(const uint32_t width, const uint32_t heigh
       .width = width,
       .height = height,
       .format = vk::Format::eD32Sfloat,
-      .usage = vk::ImageUsageFlagBits::eDepthStencilAttachment,
+      .usage = vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled,
       .aspect_flags = vk::ImageAspectFlagBits::eDepth,
   };
   depth_image_ = std::make_unique<VulkanImage>(depth_image_info, allocator_->get());
@@ -96,7 +234,7 @@ void VulkanFrame::RecreateFrameImages(const uint32_t width, const uint32_t heigh
   const ImageInfo visibility_image_info{
       .width = width,
       .height = height,
-      .format = vk::Format::eR32Uint,
+      .format = vk::Format::eR32G32Uint,
       .usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled,
       .aspect_flags = vk::ImageAspectFlagBits::eColor,
   };
@@ -112,4 +250,19 @@ void VulkanFrame::RecreateFrameImages(const uint32_t width, const uint32_t heigh
       .aspect_flags = vk::ImageAspectFlagBits::eColor,
   };
   render_image_ = std::make_unique<VulkanImage>(render_image_info, allocator_->get());
+
+  // Power of two so every level halves cleanly, the first level is at most the depth image's size
+  depth_pyramid_ = nullptr;
+  const uint32_t pyramid_width = std::bit_floor(width);
+  const uint32_t pyramid_height = std::bit_floor(height);
+  const auto pyramid_levels = static_cast<uint32_t>(std::bit_width(std::max(pyramid_width, pyramid_height)));
+  const ImageInfo depth_pyramid_info{
+      .width = pyramid_width,
+      .height = pyramid_height,
+      .format = vk::Format::eR32Sfloat,
+      .usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eStorage,
+      .aspect_flags = vk::ImageAspectFlagBits::eColor,
+      .mip_levels = std::min(pyramid_levels, kMaxDepthPyramidLevels),
+  };
+  depth_pyramid_ = std::make_unique<VulkanImage>(depth_pyramid_info, allocator_->get());
 }
@@ -4,6 +4,22 @@
 
 #include "vulkan/vulkan.hpp"
 
+// Starting sizes, the buffers grow (doubling at least) when a frame needs more.
+inline constexpr uint32_t kInitialObjectCapacity = 16384;
+inline constexpr uint32_t kInitialDrawCapacity = 32768; // per phase
+inline constexpr uint32_t kInitialObjectUpdateCapacity = 4096;
+inline constexpr uint32_t kInitialLineCapacity = 10000;
+inline constexpr uint32_t kInitialTextureFeedbackCapacity = 64;
+// Changed object table slots a frame uploads at most, the rest wait for the next frame.
+inline constexpr uint32_t kMaxObjectUpdates = 1 << 16;
+
+// Culling runs twice a frame, see VulkanRenderer::run. Each phase gets its own slice of the indirect, draw item and
+// visible object buffers and its own draw count and cluster dispatch.
+inline constexpr uint32_t kCullPhaseCount = 2;
+inline constexpr uint32_t kMaxDepthPyramidLevels = 16;
+// Mesh infos (one per lod) the instanced culling path can bin into, bigger scenes fall back to meshlet draws.
+inline constexpr uint32_t kMaxMeshInfos = 4096;
+
 class VulkanImage;
 class VulkanBuffer;
 class VulkanCommandPool;
@@ -28,12 +44,22 @@ public:
   [[nodiscard]] VulkanImage* DepthImage() const { return depth_image_.get(); }
   [[nodiscard]] VulkanImage* VisibilityImage() const { return visibility_image_.get(); }
   [[nodiscard]] VulkanImage* RenderImage() const { return render_image_.get(); }
+  [[nodiscard]] VulkanImage* DepthPyramid() const { return depth_pyramid_.get(); }
 
-  [[nodiscard]] VulkanBuffer* ObjectBuffer() const { return object_buffer_.get(); }
+  [[nodiscard]] VulkanBuffer* ObjectUpdateBuffer() const { return object_update_buffer_.get(); }
 
   [[nodiscard]] VulkanBuffer* IndirectBuffer() const { return indirect_buffer_.get(); }
 
   [[nodiscard]] VulkanBuffer* DrawCount() const { return draw_count_.get(); }
+  [[nodiscard]] VulkanBuffer* DrawCountReadback() const { return draw_count_readback_.get(); }
+
+  [[nodiscard]] VulkanBuffer* VisibleObjectBuffer() const { return visible_object_buffer_.get(); }
+  [[nodiscard]] VulkanBuffer* ClusterDispatchBuffer() const { return cluster_dispatch_.get(); }
+  [[nodiscard]] VulkanBuffer* DrawItemBuffer() const { return draw_item_buffer_.get(); }
+  [[nodiscard]] VulkanBuffer* CullDataBuffer() const { return cull_data_buffer_.get(); }
+  [[nodiscard]] VulkanBuffer* MeshInstanceBuffer() const { return mesh_instance_buffer_.get(); }
+  [[nodiscard]] VulkanBuffer* TextureFeedback() const { return texture_feedback_.get(); }
+  [[nodiscard]] VulkanBuffer* TextureFeedbackReadback() const { return texture_feedback_readback_.get(); }
 
   [[nodiscard]] VulkanBuffer* DebugLineVertexBuffer() const { return debug_line_vertex_buffer_.get(); }
 
@@ -45,6 +71,20 @@ public:
 
   void RecreateFrameImages(const uint32_t width, const uint32_t height);
 
+  // Only call these once the frame's fence is signaled, the old buffers are destroyed right away. They return true if
+  // a buffer was replaced, the frame's descriptor set has to be rewritten then.
+  bool EnsureObjectCapacity(uint32_t object_count);
+  bool EnsureDrawCapacity(uint32_t draws_per_phase);
+  bool EnsureObjectUpdateCapacity(uint32_t update_count);
+  bool EnsureLineCapacity(uint32_t line_count);
+  bool EnsureTextureFeedbackCapacity(uint32_t texture_count);
+
+  [[nodiscard]] uint32_t ObjectCapacity() const { return object_capacity_; }
+  [[nodiscard]] uint32_t DrawCapacity() const { return draw_capacity_; }
+  [[nodiscard]] uint32_t ObjectUpdateCapacity() const { return object_update_capacity_; }
+  [[nodiscard]] uint32_t LineCapacity() const { return line_capacity_; }
+  [[nodiscard]] uint32_t TextureFeedbackCapacity() const { return texture_feedback_capacity_; }
+
 private:
   vk::CommandBuffer graphics_cmd_;
 
@@ -54,14 +94,29 @@ private:
   std::unique_ptr<VulkanImage> visibility_image_;
   std::unique_ptr<VulkanImage> depth_image_;
   std::unique_ptr<VulkanImage> render_image_;
+  std::unique_ptr<VulkanImage> depth_pyramid_;
 
-  std::unique_ptr<VulkanBuffer> object_buffer_;
+  std::unique_ptr<VulkanBuffer> object_update_buffer_;
   std::unique_ptr<VulkanBuffer> indirect_buffer_;
   std::unique_ptr<VulkanBuffer> draw_count_;
+  std::unique_ptr<VulkanBuffer> draw_count_readback_;
+  std::unique_ptr<VulkanBuffer> visible_object_buffer_;
+  std::unique_ptr<VulkanBuffer> cluster_dispatch_;
+  std::unique_ptr<VulkanBuffer> draw_item_buffer_;
+  std::unique_ptr<VulkanBuffer> cull_data_buffer_;
+  std::unique_ptr<VulkanBuffer> mesh_instance_buffer_;
+  std::unique_ptr<VulkanBuffer> texture_feedback_;
+  std::unique_ptr<VulkanBuffer> texture_feedback_readback_;
   vk::DescriptorSet descriptor_set_;
 
   std::unique_ptr<VulkanBuffer> debug_line_vertex_buffer_;
 
+  uint32_t object_capacity_ = 0;
+  uint32_t draw_capacity_ = 0;
+  uint32_t object_update_capacity_ = 0;
+  uint32_t line_capacity_ = 0;
+  uint32_t texture_feedback_capacity_ = 0;
+
   VulkanDevice* device_;
   VulkanAllocator* allocator_;
 };
@@ -0,0 +1,488 @@
+#include "render/vk_geometry_heap.hpp"
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <stdexcept>
+
+#include "render/vk_barriers.hpp"
+#include "render/vk_buffer.hpp"
+#include "render/vk_device.hpp"
+#include "render/vk_upload_queue.hpp"
+#include "tracy/Tracy.hpp"
+#include "vk_allocator.hpp"
+
+// vertex streams are in units
+constexpr uint64_t kInitialPositionCapacity = 1 << 17;
+constexpr uint64_t kInitialAttributeCapacity = 1 << 18;
+constexpr uint64_t kInitialIndexCapacity = 1 << 18;
+constexpr uint64_t kInitialMeshCapacity = 256;
+constexpr uint64_t kInitialMeshletCapacity = 1 << 12;
+
+VulkanGeometryHeap::VulkanGeometryHeap(VulkanDevice* device, VulkanAllocator* allocator,
+                                       VulkanUploadQueue* uploads, const uint32_t frames_in_flight) :
+    frames_in_flight_(frames_in_flight), device_(device), allocator_(allocator), uploads_(uploads)
+{
+  positions_.usage = vk::BufferUsageFlagBits::eStorageBuffer;
+  positions_.stride = kVertexUnitSize;
+
+  attributes_.usage = vk::BufferUsageFlagBits::eStorageBuffer;
+  attributes_.stride = kVertexUnitSize;
+
+  indices_.usage = vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eStorageBuffer;
+  indices_.stride = sizeof(uint32_t);
+
+  mesh_infos_.usage = vk::BufferUsageFlagBits::eStorageBuffer;
+  mesh_infos_.stride = sizeof(MeshInfo);
+
+  meshlets_.usage = vk::BufferUsageFlagBits::eStorageBuffer;
+  meshlets_.stride = sizeof(Meshlet);
+
+  for (auto [region, capacity]: {std::pair{&positions_, kInitialPositionCapacity},
+                                 std::pair{&attributes_, kInitialAttributeCapacity},
+                                 std::pair{&indices_, kInitialIndexCapacity},
+                                 std::pair{&mesh_infos_, kInitialMeshCapacity},
+                                 std::pair{&meshlets_, kInitialMeshletCapacity}})
+  {
+    region->buffer = CreateBuffer(*region, capacity);
+    region->ranges.Grow(capacity);
+  }
+}
+
+VulkanGeometryHeap::~VulkanGeometryHeap() = default;
+
+uint32_t VulkanGeometryHeap::AddMesh(const std::span<const std::byte> positions,
+                                     const std::span<const std::byte> attributes, const VertexFormat vertex_format,
+                                     const std::span<const uint32_t> indices, const std::span<const Meshlet> meshlets,
+                                     const std::span<const MeshLod> lods, const glm::vec3& b_min,
+                                     const glm::vec3& b_max)
+{
+  ZoneScopedN("VulkanGeometryHeap::AddMesh");
+
+  const uint64_t vertex_count = positions.size() / PositionStride(vertex_format);
+  if (positions.size() % PositionStride(vertex_format) != 0 ||
+      attributes.size() != vertex_count * AttributeStride(vertex_format))
+  {
+    throw std::runtime_error("Vertex streams aren't a whole number of vertices");
+  }
+  // the mesh id is the first lod's info, without one it would alias whatever sits at offset 0
+  if (lods.empty())
+  {
+    throw std::runtime_error("Mesh has no lods");
+  }
+
+  // the next frame can reference the mesh, it waits for the batch
+  const auto cmd = uploads_->Record();
+  settled_ = false;
+  uploads_->Require(uploads_->RecordingValue());
+
+  const uint64_t position_offset = Allocate(positions_, positions.size() / kVertexUnitSize, cmd);
+  const uint64_t attribute_offset = Allocate(attributes_, attributes.size() / kVertexUnitSize, cmd);
+  const uint64_t first_index = Allocate(indices_, indices.size(), cmd);
+  const uint64_t meshlet_offset = Allocate(meshlets_, meshlets.size(), cmd);
+  // one mesh info per lod, the mesh id is the first one
+  const auto mesh_id = static_cast<uint32_t>(Allocate(mesh_infos_, lods.size(), cmd));
+  vertex_count_ += vertex_count;
+
+  meshes_[mesh_id] = {.position_offset = position_offset,
+                      .position_count = positions.size() / kVertexUnitSize,
+                      .attribute_offset = attribute_offset,
+                      .attribute_count = attributes.size() / kVertexUnitSize,
+                      .first_index = first_index,
+                      .index_count = indices.size(),
+                      .meshlet_offset = meshlet_offset,
+                      .meshlet_count = meshlets.size(),
+                      .mesh_id = mesh_id,
+                      .lod_count = lods.size(),
+                      .vertex_count = vertex_count};
+
+  std::vector<MeshInfo> infos;
+  infos.reserve(lods.size());
+  for (const auto& lod: lods)
+  {
+    infos.push_back({.b_min = b_min,
+                     .vertex_format = vertex_format,
+                     .b_max = b_max,
+                     .index_count = lod.index_count,
+                     .first_index = static_cast<uint32_t>(first_index) + lod.first_index,
+                     .vertex_offset = static_cast<int32_t>(position_offset),
+                     .meshlet_offset = static_cast<uint32_t>(meshlet_offset) + lod.meshlet_offset,
+                     .meshlet_count = lod.meshlet_count,
+                     .lod_count = static_cast<uint32_t>(lods.size()),
+                     .lod_error = lod.error,
+                     .attribute_offset = static_cast<uint32_t>(attribute_offset)});
+  }
+
+  if (mesh_id + infos.size() > mesh_info_data_.size())
+  {
+    mesh_info_data_.resize(mesh_id + infos.size());
+  }
+  std::ranges::copy(infos, mesh_info_data_.begin() + mesh_id);
+
+  // Only the new data goes through the staging ring.
+  const auto positions_size = positions.size_bytes();
+  const auto indices_size = indices.size_bytes();
+  const auto meshlets_size = meshlets.size_bytes();
+
+  if (positions_size > 0)
+  {
+    const auto staged = uploads_->Stage(positions);
+    const vk::BufferCopy region{
+        .srcOffset = staged.offset, .dstOffset = position_offset * kVertexUnitSize, .size = positions_size};
+    cmd.copyBuffer(staged.buffer, positions_.buffer->get(), 1, &region);
+
+    const auto staged_attributes = uploads_->Stage(attributes);
+    const vk::BufferCopy attribute_region{.srcOffset = staged_attributes.offset,
+                                          .dstOffset = attribute_offset * kVertexUnitSize,
+                                          .size = attributes.size_bytes()};
+    cmd.copyBuffer(staged_attributes.buffer, attributes_.buffer->get(), 1, &attribute_region);
+  }
+
+  if (indices_size > 0)
+  {
+    const auto staged = uploads_->Stage(std::as_bytes(indices));
+    const vk::BufferCopy region{
+        .srcOffset = staged.offset, .dstOffset = first_index * sizeof(uint32_t), .size = indices_size};
+    cmd.copyBuffer(staged.buffer, indices_.buffer->get(), 1, &region);
+  }
+
+  if (meshlets_size > 0)
+  {
+    const auto staged = uploads_->Stage(std::as_bytes(meshlets));
+    const vk::BufferCopy region{
+        .srcOffset = staged.offset, .dstOffset = meshlet_offset * sizeof(Meshlet), .size = meshlets_size};
+    cmd.copyBuffer(staged.buffer, meshlets_.buffer->get(), 1, &region);
+  }
+
+  const auto staged_infos = uploads_->Stage(std::as_bytes(std::span(infos)));
+  const vk::BufferCopy mesh_info_region{.srcOffset = staged_infos.offset,
+                                        .dstOffset = mesh_id * sizeof(MeshInfo),
+                                        .size = infos.size() * sizeof(MeshInfo)};
+  cmd.copyBuffer(staged_infos.buffer, mesh_infos_.buffer->get(), 1, &mesh_info_region);
+
+  return mesh_id;
+}
+
+void VulkanGeometryHeap::RemoveMesh(const uint32_t mesh_id)
+{
+  const auto it = meshes_.find(mesh_id);
+  if (it == meshes_.end())
+  {
+    throw std::runtime_error("Mesh was already removed");
+  }
+
+  const auto& ranges = it->second;
+  vertex_count_ -= ranges.vertex_count;
+  // frames in flight may still draw it and its copies may not have run yet
+  retired_meshes_.push_back(
+      {.ranges = ranges, .frames_left = frames_in_flight_, .upload = uploads_->RecordingValue()});
+
+  // the ranges it was being moved to go with it
+  std::erase_if(moves_,
+                [&](const Move& move)
+                {
+                  if (move.to.mesh_id != mesh_id)
+                  {
+                    return false;
+                  }
+                  retired_meshes_.push_back({.ranges = Moved(move.to, move.from),
+                                             .frames_left = frames_in_flight_,
+                                             .upload = uploads_->RecordingValue()});
+                  return true;
+                });
+  meshes_.erase(it);
+}
+
+void VulkanGeometryHeap::CollectRetired()
+{
+  for (auto& retired: retired_)
+  {
+    retired.frames_left -= retired.frames_left > 0 ? 1 : 0;
+  }
+  std::erase_if(retired_, [this](const RetiredBuffer& retired)
+                { return retired.frames_left == 0 && uploads_->Done(retired.upload); });
+
+  std::erase_if(retired_meshes_,
+                [this](RetiredMesh& retired)
+                {
+                  retired.frames_left -= retired.frames_left > 0 ? 1 : 0;
+                  if (retired.frames_left > 0 || !uploads_->Done(retired.upload))
+                  {
+                    return false;
+                  }
+                  Free(retired.ranges);
+                  return true;
+                });
+}
+
+void VulkanGeometryHeap::Compact(const uint64_t byte_budget)
+{
+  ZoneScopedN("VulkanGeometryHeap::Compact");
+
+  FinishMoves();
+  // one round at a time, a mesh that is on its way somewhere isn't moved again
+  if (moves_.empty() && !settled_)
+  {
+    StartMoves(byte_budget);
+    settled_ = moves_.empty();
+  }
+}
+
+void VulkanGeometryHeap::StartMoves(const uint64_t byte_budget)
+{
+  struct Movable
+  {
+    Region* region;
+    uint64_t MeshRanges::* offset;
+    uint64_t MeshRanges::* count;
+  };
+  const std::array movables{Movable{&positions_, &MeshRanges::position_offset, &MeshRanges::position_count},
+                            Movable{&attributes_, &MeshRanges::attribute_offset, &MeshRanges::attribute_count},
+                            Movable{&indices_, &MeshRanges::first_index, &MeshRanges::index_count},
+                            Movable{&meshlets_, &MeshRanges::meshlet_offset, &MeshRanges::meshlet_count}};
+
+  std::unordered_map<uint32_t, Move> moves;
+  uint64_t budget = byte_budget;
+  for (const auto& [region, offset, count]: movables)
+  {
+    // without holes everything already sits as low as it can
+    if (region->ranges.free_blocks() <= 1 || budget == 0)
+    {
+      continue;
+    }
+
+    // the highest meshes first, they leave the biggest hole at the end
+    std::vector<std::pair<uint64_t, uint32_t>> order;
+    order.reserve(meshes_.size());
+    for (const auto& [mesh_id, ranges]: meshes_)
+    {
+      if (ranges.*count > 0)
+      {
+        order.emplace_back(ranges.*offset, mesh_id);
+      }
+    }
+    std::ranges::sort(order, std::greater{});
+
+    vk::CommandBuffer cmd;
+    for (const auto& [old_offset, mesh_id]: order)
+    {
+      const auto& ranges = meshes_.at(mesh_id);
+      const uint64_t bytes = ranges.*count * region->stride;
+      // a mesh bigger than the whole budget still gets to move, on its own
+      if (bytes > budget && budget < byte_budget)
+      {
+        continue;
+      }
+
+      // first fit, so anything that isn't lower than where the mesh is won't get any better
+      const auto new_offset = region->ranges.Allocate(ranges.*count);
+      if (!new_offset || *new_offset > old_offset)
+      {
+        if (new_offset)
+        {
+          region->ranges.Free(*new_offset, ranges.*count);
+        }
+        continue;
+      }
+
+      if (!cmd)
+      {
+        cmd = uploads_->Record();
+        // earlier batches and a Grow in this one may have written what's copied
+        vulkan_barriers::BufferBarrier(
+            cmd, vulkan_barriers::BufferInfo{.buffer = region->buffer->get(), .size = vk::WholeSize},
+            vulkan_barriers::BufferUsageBit::CopyDestination, vulkan_barriers::BufferUsageBit::AllCopy);
+      }
+
+      const vk::BufferCopy copy_region{
+          .srcOffset = old_offset * region->stride, .dstOffset = *new_offset * region->stride, .size = bytes};
+      cmd.copyBuffer(region->buffer->get(), region->buffer->get(), 1, &copy_region);
+
+      auto [it, inserted] = moves.try_emplace(mesh_id, Move{.from = ranges, .to = ranges});
+      it->second.to.*offset = *new_offset;
+      budget -= std::min(bytes, budget);
+    }
+  }
+
+  for (auto& [mesh_id, move]: moves)
+  {
+    move.upload = uploads_->RecordingValue();
+    moves_.push_back(move);
+  }
+}
+
+void VulkanGeometryHeap::FinishMoves()
+{
+  if (moves_.empty())
+  {
+    return;
+  }
+
+  // the data is at both places now, the frame rewrites the infos before anything reads them
+  std::erase_if(moves_,
+                [&](const Move& move)
+                {
+                  if (!uploads_->Done(move.upload))
+                  {
+                    return false;
+                  }
+
+                  const auto mesh_id = static_cast<uint32_t>(move.to.mesh_id);
+                  const auto infos = std::span(mesh_info_data_).subspan(mesh_id, move.to.lod_count);
+                  for (auto& info: infos)
+                  {
+                    info.first_index += static_cast<uint32_t>(move.to.first_index - move.from.first_index);
+                    info.meshlet_offset += static_cast<uint32_t>(move.to.meshlet_offset - move.from.meshlet_offset);
+                    info.vertex_offset = static_cast<int32_t>(move.to.position_offset);
+                    info.attribute_offset = static_cast<uint32_t>(move.to.attribute_offset);
+                  }
+
+                  info_updates_.push_back(mesh_id);
+                  // the frame has to see the copies, waiting on a value that's already reached costs nothing
+                  uploads_->Require(move.upload);
+
+                  // frames in flight still read the old infos
+                  retired_meshes_.push_back({.ranges = Moved(move.from, move.to), .frames_left = frames_in_flight_});
+                  meshes_.at(mesh_id) = move.to;
+                  return true;
+                });
+}
+
+void VulkanGeometryHeap::RecordInfoUpdates(const vk::CommandBuffer cmd)
+{
+  if (info_updates_.empty())
+  {
+    return;
+  }
+
+  const vulkan_barriers::BufferInfo infos_info{.buffer = mesh_infos_.buffer->get(), .size = vk::WholeSize};
+
+  // the previous frame's culling and drawing still read the old infos
+  vulkan_barriers::BufferBarrier(cmd, infos_info, vulkan_barriers::BufferUsageBit::AllR,
+                                 vulkan_barriers::BufferUsageBit::CopyDestination);
+
+  for (const auto mesh_id: info_updates_)
+  {
+    const auto it = meshes_.find(mesh_id);
+    if (it == meshes_.end())
+    {
+      continue;
+    }
+    const auto infos = std::span(mesh_info_data_).subspan(mesh_id, it->second.lod_count);
+    cmd.updateBuffer(mesh_infos_.buffer->get(), mesh_id * sizeof(MeshInfo), infos.size_bytes(), infos.data());
+  }
+  info_updates_.clear();
+
+  vulkan_barriers::BufferBarrier(cmd, infos_info, vulkan_barriers::BufferUsageBit::CopyDestination,
+                                 vulkan_barriers::BufferUsageBit::AllR);
+}
+
+// static
+VulkanGeometryHeap::MeshRanges VulkanGeometryHeap::Moved(const MeshRanges& ranges, const MeshRanges& other)
+{
+  MeshRanges moved{};
+  if (ranges.position_offset != other.position_offset)
+  {
+    moved.position_offset = ranges.position_offset;
+    moved.position_count = ranges.position_count;
+  }
+  if (ranges.attribute_offset != other.attribute_offset)
+  {
+    moved.attribute_offset = ranges.attribute_offset;
+    moved.attribute_count = ranges.attribute_count;
+  }
+  if (ranges.first_index != other.first_index)
+  {
+    moved.first_index = ranges.first_index;
+    moved.index_count = ranges.index_count;
+  }
+  if (ranges.meshlet_offset != other.meshlet_offset)
+  {
+    moved.meshlet_offset = ranges.meshlet_offset;
+    moved.meshlet_count = ranges.meshlet_count;
+  }
+  return moved;
+}
+
+void VulkanGeometryHeap::Free(const MeshRanges& ranges)
+{
+  settled_ = false;
+  positions_.ranges.Free(ranges.position_offset, ranges.position_count);
+  attributes_.ranges.Free(ranges.attribute_offset, ranges.attribute_count);
+  indices_.ranges.Free(ranges.first_index, ranges.index_count);
+  meshlets_.ranges.Free(ranges.meshlet_offset, ranges.meshlet_count);
+  mesh_infos_.ranges.Free(ranges.mesh_id, ranges.lod_count);
+  // the gpu copy keeps the stale infos until the ids are reused, nothing references them
+  std::fill_n(mesh_info_data_.begin() + static_cast<std::ptrdiff_t>(ranges.mesh_id), ranges.lod_count, MeshInfo{});
+}
+
+uint64_t VulkanGeometryHeap::Allocate(Region& region, const uint64_t count, const vk::CommandBuffer cmd)
+{
+  if (count == 0)
+  {
+    return 0;
+  }
+
+  auto offset = region.ranges.Allocate(count);
+  if (!offset)
+  {
+    Grow(region, region.ranges.capacity() + count, cmd);
+    offset = region.ranges.Allocate(count);
+  }
+
+  return offset.value();
+}
+
+void VulkanGeometryHeap::Grow(Region& region, const uint64_t min_capacity, const vk::CommandBuffer cmd)
+{
+  const uint64_t old_capacity = region.ranges.capacity();
+  const uint64_t new_capacity = std::max(min_capacity, old_capacity * 2);
+
+  auto buffer = CreateBuffer(region, new_capacity);
+
+  // earlier meshes in the same batch may have just been copied into the old buffer
+  vulkan_barriers::BufferBarrier(cmd,
+                                 vulkan_barriers::BufferInfo{.buffer = region.buffer->get(), .size = vk::WholeSize},
+                                 vulkan_barriers::BufferUsageBit::CopyDestination,
+                                 vulkan_barriers::BufferUsageBit::CopySource);
+
+  if (&region == &mesh_infos_)
+  {
+    // Frames rewrite infos of moved meshes on the graphics queue, reading the old buffer here could race that. The
+    // cpu copy is always up to date.
+    if (const auto staged = uploads_->Stage(std::as_bytes(std::span(mesh_info_data_))); staged.buffer)
+    {
+      const vk::BufferCopy copy_region{
+          .srcOffset = staged.offset, .dstOffset = 0, .size = mesh_info_data_.size() * sizeof(MeshInfo)};
+      cmd.copyBuffer(staged.buffer, buffer->get(), 1, &copy_region);
+    }
+  } else
+  {
+    // Everything keeps its offset, so copying the old buffer to the start of the new one is enough.
+    const vk::BufferCopy copy_region{.srcOffset = 0, .dstOffset = 0, .size = old_capacity * region.stride};
+    cmd.copyBuffer(region.buffer->get(), buffer->get(), 1, &copy_region);
+  }
+
+  // The new allocation might land in a hole below the old capacity, don't let its copy race this one.
+  vulkan_barriers::BufferBarrier(cmd, vulkan_barriers::BufferInfo{.buffer = buffer->get(), .size = vk::WholeSize},
+                                 vulkan_barriers::BufferUsageBit::CopyDestination,
+                                 vulkan_barriers::BufferUsageBit::CopyDestination);
+
+  // Frames in flight still reference the old buffer and the copy out of it hasn't run yet
+  retired_.push_back(
+      {.buffer = std::move(region.buffer), .frames_left = frames_in_flight_, .upload = uploads_->RecordingValue()});
+
+  region.buffer = std::move(buffer);
+  region.ranges.Grow(new_capacity);
+  ++generation_;
+}
+
+std::unique_ptr<VulkanBuffer> VulkanGeometryHeap::CreateBuffer(const Region& region, const uint64_t capacity) const
+{
+  return std::make_unique<VulkanBuffer>(
+      BufferInfo{.size = capacity * region.stride,
+                 .usage = region.usage | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc,
+                 .memoryUsage = VMA_MEMORY_USAGE_GPU_ONLY,
+                 .memoryFlags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT},
+      allocator_->get(), device_);
+}
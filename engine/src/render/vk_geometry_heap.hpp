@@ -0,0 +1,145 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <memory>
+#include <span>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+#include "render/vk_renderer.hpp"
+#include "util/range_allocator.hpp"
+
+class VulkanBuffer;
+class VulkanAllocator;
+class VulkanDevice;
+class VulkanUploadQueue;
+
+// Persistent vertex, index, meshlet and mesh info buffers. Meshes are sub-allocated and appended with a staging copy.
+// Removed meshes leave holes, Compact moves the meshes above them down a few at a time, the frame points their infos
+// at the new ranges once the copies are done. When a buffer runs out of space it is replaced by a bigger one, the old
+// contents are copied over at the same offsets and the old buffer is kept alive until the frames in flight are done.
+// The copies go through the upload queue, the next frame waits for them on the gpu. Vertices are split into a position
+// and an attribute stream, both hold meshes of every vertex format and are allocated in kVertexUnitSize units.
+class VulkanGeometryHeap
+{
+public:
+  VulkanGeometryHeap(VulkanDevice* device, VulkanAllocator* allocator, VulkanUploadQueue* uploads,
+                     uint32_t frames_in_flight);
+  VulkanGeometryHeap(const VulkanGeometryHeap&) = delete;
+  VulkanGeometryHeap(VulkanGeometryHeap&&) = delete;
+  VulkanGeometryHeap& operator=(const VulkanGeometryHeap&) = delete;
+  VulkanGeometryHeap& operator=(VulkanGeometryHeap&&) = delete;
+  ~VulkanGeometryHeap();
+
+  uint32_t AddMesh(std::span<const std::byte> positions, std::span<const std::byte> attributes,
+                   VertexFormat vertex_format, std::span<const uint32_t> indices, std::span<const Meshlet> meshlets,
+                   std::span<const MeshLod> lods, const glm::vec3& b_min, const glm::vec3& b_max);
+  // Nothing may draw the mesh anymore. Its ranges are reused once the frames in flight and its upload are done.
+  void RemoveMesh(uint32_t mesh_id);
+
+  // Call once per frame after the frame fence was waited on.
+  void CollectRetired();
+  // Moves meshes down into the holes removed meshes left behind, copying at most about byte_budget bytes. Call once
+  // per frame, after CollectRetired. Once a pass finds nothing to move it waits for a free or a new mesh.
+  void Compact(uint64_t byte_budget);
+  // Points the infos of meshes whose moves finished at their new ranges. Call at the start of the frame's commands,
+  // before anything reads the infos.
+  void RecordInfoUpdates(vk::CommandBuffer cmd);
+
+  [[nodiscard]] VulkanBuffer* PositionBuffer() const { return positions_.buffer.get(); }
+  [[nodiscard]] VulkanBuffer* AttributeBuffer() const { return attributes_.buffer.get(); }
+  [[nodiscard]] VulkanBuffer* IndexBuffer() const { return indices_.buffer.get(); }
+  [[nodiscard]] VulkanBuffer* MeshInfoBuffer() const { return mesh_infos_.buffer.get(); }
+  [[nodiscard]] VulkanBuffer* MeshletBuffer() const { return meshlets_.buffer.get(); }
+
+  // Changes whenever one of the buffers above got replaced, descriptors pointing at them need to be rewritten.
+  [[nodiscard]] uint64_t Generation() const { return generation_; }
+
+  [[nodiscard]] const std::vector<MeshInfo>& MeshInfos() const { return mesh_info_data_; }
+  [[nodiscard]] uint64_t VertexCount() const { return vertex_count_; }
+  [[nodiscard]] uint64_t VertexBytes() const
+  {
+    return (positions_.ranges.used() + attributes_.ranges.used()) * kVertexUnitSize;
+  }
+  [[nodiscard]] uint64_t IndexCount() const { return indices_.ranges.used(); }
+
+private:
+  struct Region
+  {
+    std::unique_ptr<VulkanBuffer> buffer;
+    util::RangeAllocator ranges;
+    vk::BufferUsageFlags usage;
+    size_t stride{};
+  };
+
+  struct RetiredBuffer
+  {
+    std::unique_ptr<VulkanBuffer> buffer;
+    uint32_t frames_left{};
+    uint64_t upload{}; // the copy out of it
+  };
+
+  // Where a mesh lives in each region, in the region's units.
+  struct MeshRanges
+  {
+    uint64_t position_offset{};
+    uint64_t position_count{};
+    uint64_t attribute_offset{};
+    uint64_t attribute_count{};
+    uint64_t first_index{};
+    uint64_t index_count{};
+    uint64_t meshlet_offset{};
+    uint64_t meshlet_count{};
+    uint64_t mesh_id{};
+    uint64_t lod_count{};
+    uint64_t vertex_count{};
+  };
+
+  struct RetiredMesh
+  {
+    MeshRanges ranges;
+    uint32_t frames_left{};
+    uint64_t upload{}; // a batch that may still copy into the ranges
+  };
+
+  // A mesh whose data was copied to new ranges, its infos still point at the old ones until the copy is done.
+  struct Move
+  {
+    MeshRanges from;
+    MeshRanges to;
+    uint64_t upload{};
+  };
+
+  // the ranges of ranges whose offset differs in other, the rest are empty and freeing them does nothing
+  [[nodiscard]] static MeshRanges Moved(const MeshRanges& ranges, const MeshRanges& other);
+  void Free(const MeshRanges& ranges);
+  void StartMoves(uint64_t byte_budget);
+  void FinishMoves();
+
+  uint64_t Allocate(Region& region, uint64_t count, vk::CommandBuffer cmd);
+  void Grow(Region& region, uint64_t min_capacity, vk::CommandBuffer cmd);
+  [[nodiscard]] std::unique_ptr<VulkanBuffer> CreateBuffer(const Region& region, uint64_t capacity) const;
+
+  Region positions_;
+  Region attributes_;
+  Region indices_;
+  Region mesh_infos_;
+  Region meshlets_;
+
+  std::vector<MeshInfo> mesh_info_data_;
+  std::unordered_map<uint32_t, MeshRanges> meshes_; // by mesh id
+  uint64_t vertex_count_ = 0;
+
+  std::vector<RetiredBuffer> retired_;
+  std::vector<RetiredMesh> retired_meshes_;
+  std::vector<Move> moves_;
+  std::vector<uint32_t> info_updates_; // meshes whose infos the next frame rewrites
+  bool settled_ = false; // the last pass found nothing to move, until ranges are freed or a mesh is added
+  uint64_t generation_ = 0;
+  uint32_t frames_in_flight_;
+
+  VulkanDevice* device_;
+  VulkanAllocator* allocator_;
+  VulkanUploadQueue* uploads_;
+};
@@ -3,7 +3,8 @@
 #include "util/vk_check.hpp"
 
 VulkanImage::VulkanImage(const ImageInfo &info, const VmaAllocator allocator) :
-    format_(info.format), width_(info.width), height_(info.height), allocator_(allocator)
+    format_(info.format), width_(info.width), height_(info.height), mip_levels_(info.mip_levels),
+    array_layers_(info.array_layers), allocator_(allocator)
 {
   VmaAllocatorInfo allocator_info;
   vmaGetAllocatorInfo(allocator_, &allocator_info);
@@ -25,7 +26,12 @@ void VulkanImage::TransitionLayout(const vk::CommandBuffer cmd, const vk::ImageL
 void VulkanImage::TransitionImageLayout(const vk::Image image, const vk::CommandBuffer cmd,
                                         const vk::ImageLayout old_layout, const vk::ImageLayout new_layout)
 {
-  const vk::ImageAspectFlags aspect_mask = (new_layout == vk::ImageLayout::eDepthAttachmentOptimal)
+  const auto is_depth_layout = [](const vk::ImageLayout layout)
+  {
+    return layout == vk::ImageLayout::eDepthAttachmentOptimal ||
+           layout == vk::ImageLayout::eDepthStencilAttachmentOptimal;
+  };
+  const vk::ImageAspectFlags aspect_mask = (is_depth_layout(old_layout) || is_depth_layout(new_layout))
                                                ? vk::ImageAspectFlagBits::eDepth
                                                : vk::ImageAspectFlagBits::eColor;
 
@@ -119,6 +125,52 @@ void VulkanImage::TransitionImageLayout(const vk::Image image, const vk::Command
         vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite;
     barrier.srcStageMask = vk::PipelineStageFlagBits2::eTopOfPipe;
     barrier.dstStageMask = vk::PipelineStageFlagBits2::eEarlyFragmentTests;
+  } else if (old_layout == vk::ImageLayout::eUndefined && new_layout == vk::ImageLayout::eDepthAttachmentOptimal)
+  {
+    barrier.srcAccessMask = vk::AccessFlagBits2::eNone;
+    barrier.dstAccessMask =
+        vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite;
+    barrier.srcStageMask = vk::PipelineStageFlagBits2::eTopOfPipe;
+    barrier.dstStageMask =
+        vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests;
+  } else if (old_layout == vk::ImageLayout::eDepthAttachmentOptimal &&
+             new_layout == vk::ImageLayout::eShaderReadOnlyOptimal)
+  {
+    barrier.srcAccessMask = vk::AccessFlagBits2::eDepthStencilAttachmentWrite;
+    barrier.dstAccessMask = vk::AccessFlagBits2::eShaderRead;
+    barrier.srcStageMask =
+        vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests;
+    barrier.dstStageMask = vk::PipelineStageFlagBits2::eComputeShader;
+  } else if (old_layout == vk::ImageLayout::eShaderReadOnlyOptimal &&
+             new_layout == vk::ImageLayout::eDepthAttachmentOptimal)
+  {
+    barrier.srcAccessMask = vk::AccessFlagBits2::eShaderRead;
+    barrier.dstAccessMask =
+        vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite;
+    barrier.srcStageMask = vk::PipelineStageFlagBits2::eComputeShader;
+    barrier.dstStageMask =
+        vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests;
+  } else if (old_layout == vk::ImageLayout::eColorAttachmentOptimal &&
+             new_layout == vk::ImageLayout::eColorAttachmentOptimal)
+  {
+    // two passes drawing into the same attachment
+    barrier.srcAccessMask = vk::AccessFlagBits2::eColorAttachmentWrite;
+    barrier.dstAccessMask = vk::AccessFlagBits2::eColorAttachmentWrite | vk::AccessFlagBits2::eColorAttachmentRead;
+    barrier.srcStageMask = vk::PipelineStageFlagBits2::eColorAttachmentOutput;
+    barrier.dstStageMask = vk::PipelineStageFlagBits2::eColorAttachmentOutput;
+  } else if (old_layout == vk::ImageLayout::eUndefined && new_layout == vk::ImageLayout::eGeneral)
+  {
+    barrier.srcAccessMask = vk::AccessFlagBits2::eNone;
+    barrier.dstAccessMask = vk::AccessFlagBits2::eShaderStorageWrite;
+    barrier.srcStageMask = vk::PipelineStageFlagBits2::eTopOfPipe;
+    barrier.dstStageMask = vk::PipelineStageFlagBits2::eComputeShader;
+  } else if (old_layout == vk::ImageLayout::eGeneral && new_layout == vk::ImageLayout::eGeneral)
+  {
+    // compute writes made visible to the next compute dispatch, eg. between mip levels
+    barrier.srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite;
+    barrier.dstAccessMask = vk::AccessFlagBits2::eShaderRead | vk::AccessFlagBits2::eShaderStorageWrite;
+    barrier.srcStageMask = vk::PipelineStageFlagBits2::eComputeShader;
+    barrier.dstStageMask = vk::PipelineStageFlagBits2::eComputeShader;
   } else if (old_layout == vk::ImageLayout::eUndefined && new_layout == vk::ImageLayout::eColorAttachmentOptimal)
   {
     barrier.srcAccessMask = vk::AccessFlagBits2::eNone;
@@ -161,6 +213,11 @@ void VulkanImage::TransitionImageLayout(const vk::Image image, const vk::Command
 
 void VulkanImage::Destroy()
 {
+  for (const auto view: mip_views_)
+  {
+    device_.destroyImageView(view);
+  }
+  mip_views_.clear();
   if (image_view_)
   {
     device_.destroyImageView(image_view_);
@@ -179,12 +236,15 @@ void VulkanImage::Create(const ImageInfo &info)
   vk::ImageCreateInfo image_info{.imageType = vk::ImageType::e2D,
                                  .format = info.format,
                                  .extent = vk::Extent3D{.width = info.width, .height = info.height, .depth = 1},
-                                 .mipLevels = 1,
-                                 .arrayLayers = 1,
+                                 .mipLevels = info.mip_levels,
+                                 .arrayLayers = info.array_layers,
                                  .samples = vk::SampleCountFlagBits::e1,
                                  .tiling = vk::ImageTiling::eOptimal,
                                  .usage = info.usage,
-                                 .sharingMode = vk::SharingMode::eExclusive,
+                                 .sharingMode = info.queue_families.size() > 1 ? vk::SharingMode::eConcurrent
+                                                                               : vk::SharingMode::eExclusive,
+                                 .queueFamilyIndexCount = static_cast<uint32_t>(info.queue_families.size()),
+                                 .pQueueFamilyIndices = info.queue_families.data(),
                                  .initialLayout = vk::ImageLayout::eUndefined};
 
   VmaAllocationCreateInfo alloc_info{};
@@ -202,10 +262,27 @@ void VulkanImage::CreateView(const vk::ImageAspectFlags aspect_flags)
 {
   const vk::ImageViewCreateInfo view_info{
       .image = image_,
-      .viewType = vk::ImageViewType::e2D,
+      .viewType = array_layers_ == 1 ? vk::ImageViewType::e2D : vk::ImageViewType::e2DArray,
       .format = format_,
-      .subresourceRange = vk::ImageSubresourceRange{
-          .aspectMask = aspect_flags, .baseMipLevel = 0, .levelCount = 1, .baseArrayLayer = 0, .layerCount = 1}};
+      .subresourceRange = vk::ImageSubresourceRange{.aspectMask = aspect_flags,
+                                                    .baseMipLevel = 0,
+                                                    .levelCount = mip_levels_,
+                                                    .baseArrayLayer = 0,
+                                                    .layerCount = array_layers_}};
 
   image_view_ = device_.createImageView(view_info);
+
+  if (mip_levels_ == 1)
+  {
+    return;
+  }
+
+  mip_views_.reserve(mip_levels_);
+  for (uint32_t level{}; level < mip_levels_; level++)
+  {
+    auto mip_view_info = view_info;
+    mip_view_info.subresourceRange.baseMipLevel = level;
+    mip_view_info.subresourceRange.levelCount = 1;
+    mip_views_.push_back(device_.createImageView(mip_view_info));
+  }
 }
@@ -1,6 +1,7 @@
 #pragma once
 #include <vma/vma_usage.h>
 
+#include <vector>
 #include <vulkan/vulkan.hpp>
 
 struct ImageInfo
@@ -10,6 +11,9 @@ struct ImageInfo
   vk::Format format;
   vk::ImageUsageFlags usage;
   vk::ImageAspectFlags aspect_flags;
+  uint32_t mip_levels = 1;
+  uint32_t array_layers = 1; // more than one gets an array view
+  std::vector<uint32_t> queue_families; // more than one shares the image between them, no ownership transfers
 };
 
 class VulkanImage
@@ -25,10 +29,17 @@ public:
   [[nodiscard]] vk::Image get() const { return image_; }
 
   [[nodiscard]] vk::ImageView view() const { return image_view_; }
+  // single level view, images with one level just have the full view
+  [[nodiscard]] vk::ImageView MipView(const uint32_t level) const
+  {
+    return mip_views_.empty() ? image_view_ : mip_views_.at(level);
+  }
   [[nodiscard]] VmaAllocation allocation() const { return allocation_; }
   [[nodiscard]] vk::Format format() const { return format_; }
   [[nodiscard]] uint32_t width() const { return width_; }
   [[nodiscard]] uint32_t height() const { return height_; }
+  [[nodiscard]] uint32_t MipLevels() const { return mip_levels_; }
+  [[nodiscard]] uint32_t ArrayLayers() const { return array_layers_; }
 
   void TransitionLayout(vk::CommandBuffer cmd, vk::ImageLayout old_layout, vk::ImageLayout new_layout) const;
 
@@ -39,11 +50,14 @@ public:
 private:
   vk::Image image_;
   vk::ImageView image_view_;
+  std::vector<vk::ImageView> mip_views_;
   VmaAllocation allocation_ = VK_NULL_HANDLE;
 
   vk::Format format_;
   uint32_t width_;
   uint32_t height_;
+  uint32_t mip_levels_;
+  uint32_t array_layers_;
 
   VmaAllocator allocator_;
   vk::Device device_;
@@ -3,13 +3,19 @@
 #include <SDL3/SDL.h>
 #include <vulkan/vulkan_core.h>
 
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include <cstdint>
 #include <memory>
 #include <stdexcept>
+#include <string_view>
+#include <utility>
 
 #include "core/events.hpp"
+#include "core/job_system.hpp"
 #include "core/window.hpp"
+#include "files/files.hpp"
 #include "glm/ext/matrix_clip_space.hpp"
 #include "glm/ext/matrix_transform.hpp"
 #include "imgui.h"
@@ -20,11 +26,15 @@
 #include "render/vk_descriptor.hpp"
 #include "render/vk_device.hpp"
 #include "render/vk_frame.hpp"
+#include "render/vk_geometry_heap.hpp"
 #include "render/vk_image.hpp"
 #include "render/vk_instance.hpp"
 #include "render/vk_shader.hpp"
+#include "render/vk_shader_reloader.hpp"
 #include "render/vk_surface.hpp"
 #include "render/vk_swap_chain.hpp"
+#include "render/vk_texture_streamer.hpp"
+#include "render/vk_upload_queue.hpp"
 #include "resource/resource_manager.hpp"
 #include "resource/types/shader_resource.hpp"
 #include "tracy/Tracy.hpp"
@@ -38,13 +48,19 @@
 constexpr float kNearPlaneDistance = 0.01F;
 constexpr float kFarPlaneDistance = 1000.0F;
 constexpr uint32_t kMaxDescriptorSets = 1000;
-constexpr uint32_t kStorageBufferCount = 20;
-constexpr uint32_t kStorageImageCount = 20;
-constexpr uint32_t kCombinedImageSamplerCount = 20;
-constexpr uint32_t kMaxTextures = 20;
-
-VulkanRenderer::VulkanRenderer(Window* window, ResourceManager& resource_manager, EventManager& event_manager) :
-    window_(window), event_manager_(&event_manager)
+constexpr uint32_t kStorageBufferCount = 64;
+constexpr uint32_t kStorageImageCount = 64;
+constexpr uint32_t kCombinedImageSamplerCount = 128;
+// upper bound for the bindless texture table, the device limit can lower it
+constexpr uint32_t kMaxBindlessTextures = 1 << 15;
+constexpr uint64_t kDefaultTextureBudget = 256ULL << 20;
+// every upload copies out of this, bigger ones get their own staging buffer
+constexpr uint64_t kStagingRingSize = 64ULL << 20;
+// geometry bytes moved per frame to close the holes unloaded meshes leave
+constexpr uint64_t kCompactionBudget = 4ULL << 20;
+
+VulkanRenderer::VulkanRenderer(Window* window, ResourceManager& resource_manager, EventManager& event_manager,
+                               JobSystem& jobs) : window_(window), event_manager_(&event_manager), jobs_(&jobs)
 {
   util::println("Initializing renderer");
 
@@ -81,6 +97,8 @@ VulkanRenderer::VulkanRenderer(Window* window, ResourceManager& resource_manager
 
   transfer_pool_ = std::make_unique<VulkanCommandPool>(
       CommandPoolInfo{.queue_family_index = transfer_queue_family, .flags = {}}, device_->get());
+  uploads_ = std::make_unique<VulkanUploadQueue>(device_.get(), allocator_.get(), transfer_pool_.get(),
+                                                 kStagingRingSize);
 
   // -----------------------------------------------------------
   // TRANSITION SWAPCHAIN IMAGES TO PRESENT
@@ -135,14 +153,41 @@ VulkanRenderer::VulkanRenderer(Window* window, ResourceManager& resource_manager
 
   texture_sampler_ = device_->get().createSamplerUnique(tex_sampler_create_info);
 
+  // max reduction, a linear sample returns the farthest of the texels it touches instead of their average
+  constexpr vk::SamplerReductionModeCreateInfo depth_pyramid_reduction{.reductionMode = vk::SamplerReductionMode::eMax};
+  const vk::SamplerCreateInfo depth_pyramid_sampler_create_info{
+      .pNext = &depth_pyramid_reduction,
+      .magFilter = vk::Filter::eLinear,
+      .minFilter = vk::Filter::eLinear,
+      .mipmapMode = vk::SamplerMipmapMode::eNearest,
+      .addressModeU = vk::SamplerAddressMode::eClampToEdge,
+      .addressModeV = vk::SamplerAddressMode::eClampToEdge,
+      .addressModeW = vk::SamplerAddressMode::eClampToEdge,
+      .mipLodBias = 0.0f,
+      .anisotropyEnable = vk::False,
+      .maxAnisotropy = 1.0f,
+      .compareEnable = vk::False,
+      .minLod = 0.0f,
+      .maxLod = vk::LodClampNone,
+      .borderColor = vk::BorderColor::eFloatOpaqueBlack,
+      .unnormalizedCoordinates = vk::False,
+  };
+
+  depth_pyramid_sampler_ = device_->get().createSamplerUnique(depth_pyramid_sampler_create_info);
+
   // -----------------------------------------------------------
   // CREATE DESCRIPTOR POOL
   // -----------------------------------------------------------
+  texture_capacity_ = std::min(kMaxBindlessTextures, device_->MaxUpdateAfterBindTextures() / max_frames_in_flight_);
+
+  // the texture tables of the static sets are update after bind, they need their own room in the pool
   DescriptorPoolInfo descriptor_pool_info{};
-  descriptor_pool_info.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
+  descriptor_pool_info.flags =
+      vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet | vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind;
   descriptor_pool_info.max_sets = kMaxDescriptorSets;
   descriptor_pool_info.pool_sizes = {
-      {.type = vk::DescriptorType::eCombinedImageSampler, .descriptorCount = kCombinedImageSamplerCount},
+      {.type = vk::DescriptorType::eCombinedImageSampler,
+       .descriptorCount = kCombinedImageSamplerCount + (texture_capacity_ * max_frames_in_flight_)},
       {.type = vk::DescriptorType::eStorageBuffer, .descriptorCount = kStorageBufferCount},
       {.type = vk::DescriptorType::eStorageImage, .descriptorCount = kStorageImageCount}};
 
@@ -178,9 +223,75 @@ VulkanRenderer::VulkanRenderer(Window* window, ResourceManager& resource_manager
                                                  .binding = 4,
                                                  .descriptorType = vk::DescriptorType::eStorageImage,
                                                  .descriptorCount = 1,
+                                                 .stageFlags = vk::ShaderStageFlagBits::eCompute},
+                  vk::DescriptorSetLayoutBinding{// visibleObjects
+                                                 .binding = 5,
+                                                 .descriptorType = vk::DescriptorType::eStorageBuffer,
+                                                 .descriptorCount = 1,
+                                                 .stageFlags = vk::ShaderStageFlagBits::eCompute},
+                  vk::DescriptorSetLayoutBinding{// clusterDispatch
+                                                 .binding = 6,
+                                                 .descriptorType = vk::DescriptorType::eStorageBuffer,
+                                                 .descriptorCount = 1,
+                                                 .stageFlags = vk::ShaderStageFlagBits::eCompute},
+                  vk::DescriptorSetLayoutBinding{
+                      // drawItems
+                      .binding = 7,
+                      .descriptorType = vk::DescriptorType::eStorageBuffer,
+                      .descriptorCount = 1,
+                      .stageFlags = vk::ShaderStageFlagBits::eCompute | vk::ShaderStageFlagBits::eVertex},
+                  vk::DescriptorSetLayoutBinding{// cullData
+                                                 .binding = 8,
+                                                 .descriptorType = vk::DescriptorType::eStorageBuffer,
+                                                 .descriptorCount = 1,
+                                                 .stageFlags = vk::ShaderStageFlagBits::eCompute},
+                  vk::DescriptorSetLayoutBinding{// objectVisibility
+                                                 .binding = 9,
+                                                 .descriptorType = vk::DescriptorType::eStorageBuffer,
+                                                 .descriptorCount = 1,
+                                                 .stageFlags = vk::ShaderStageFlagBits::eCompute},
+                  vk::DescriptorSetLayoutBinding{// depthPyramid
+                                                 .binding = 10,
+                                                 .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+                                                 .descriptorCount = 1,
+                                                 .stageFlags = vk::ShaderStageFlagBits::eCompute},
+                  vk::DescriptorSetLayoutBinding{// meshInstances
+                                                 .binding = 11,
+                                                 .descriptorType = vk::DescriptorType::eStorageBuffer,
+                                                 .descriptorCount = 1,
+                                                 .stageFlags = vk::ShaderStageFlagBits::eCompute},
+                  vk::DescriptorSetLayoutBinding{// objectUpdates
+                                                 .binding = 12,
+                                                 .descriptorType = vk::DescriptorType::eStorageBuffer,
+                                                 .descriptorCount = 1,
+                                                 .stageFlags = vk::ShaderStageFlagBits::eCompute},
+                  vk::DescriptorSetLayoutBinding{// textureFeedback
+                                                 .binding = 13,
+                                                 .descriptorType = vk::DescriptorType::eStorageBuffer,
+                                                 .descriptorCount = 1,
+                                                 .stageFlags = vk::ShaderStageFlagBits::eCompute}},
+      std::vector<vk::DescriptorBindingFlags>{}, vk::DescriptorSetLayoutCreateFlags{});
+
+  depth_pyramid_descriptor_set_layout_ = std::make_unique<VulkanDescriptorSetLayout>(
+      device_->get(),
+      std::vector{vk::DescriptorSetLayoutBinding{// inputImage
+                                                 .binding = 0,
+                                                 .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+                                                 .descriptorCount = 1,
+                                                 .stageFlags = vk::ShaderStageFlagBits::eCompute},
+                  vk::DescriptorSetLayoutBinding{// outputImage
+                                                 .binding = 1,
+                                                 .descriptorType = vk::DescriptorType::eStorageImage,
+                                                 .descriptorCount = 1,
                                                  .stageFlags = vk::ShaderStageFlagBits::eCompute}},
       std::vector<vk::DescriptorBindingFlags>{}, vk::DescriptorSetLayoutCreateFlags{});
 
+  for (auto& sets: depth_pyramid_descriptor_sets_)
+  {
+    sets = descriptor_pool_->allocate(
+        std::vector<vk::DescriptorSetLayout>(kMaxDepthPyramidLevels, depth_pyramid_descriptor_set_layout_->get()));
+  }
+
   static_descriptor_set_layout_ = std::make_unique<VulkanDescriptorSetLayout>(
       device_->get(),
       std::vector{vk::DescriptorSetLayoutBinding{
@@ -193,24 +304,40 @@ VulkanRenderer::VulkanRenderer(Window* window, ResourceManager& resource_manager
                       // Textures
                       .binding = 1,
                       .descriptorType = vk::DescriptorType::eCombinedImageSampler,
-                      .descriptorCount = kMaxTextures,
+                      .descriptorCount = texture_capacity_,
                       .stageFlags = vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute},
-                  vk::DescriptorSetLayoutBinding{// vertexBuffer
-                                                 .binding = 2,
+                  vk::DescriptorSetLayoutBinding{
+                      // vertexPositions
+                      .binding = 2,
+                      .descriptorType = vk::DescriptorType::eStorageBuffer,
+                      .descriptorCount = 1,
+                      .stageFlags = vk::ShaderStageFlagBits::eCompute | vk::ShaderStageFlagBits::eVertex},
+                  vk::DescriptorSetLayoutBinding{// indexBuffer
+                                                 .binding = 3,
                                                  .descriptorType = vk::DescriptorType::eStorageBuffer,
                                                  .descriptorCount = 1,
                                                  .stageFlags = vk::ShaderStageFlagBits::eCompute},
-                  vk::DescriptorSetLayoutBinding{// indexBuffer
-                                                 .binding = 3,
+                  vk::DescriptorSetLayoutBinding{// meshlets
+                                                 .binding = 4,
+                                                 .descriptorType = vk::DescriptorType::eStorageBuffer,
+                                                 .descriptorCount = 1,
+                                                 .stageFlags = vk::ShaderStageFlagBits::eCompute},
+                  vk::DescriptorSetLayoutBinding{// vertexAttributes
+                                                 .binding = 5,
                                                  .descriptorType = vk::DescriptorType::eStorageBuffer,
                                                  .descriptorCount = 1,
                                                  .stageFlags = vk::ShaderStageFlagBits::eCompute}},
-      std::vector<vk::DescriptorBindingFlags>{vk::DescriptorBindingFlags{},
-                                              vk::DescriptorBindingFlagBits::ePartiallyBound,
-                                              vk::DescriptorBindingFlags{}, vk::DescriptorBindingFlags{}},
-      vk::DescriptorSetLayoutCreateFlags{});
-
-  static_descriptor_set_ = descriptor_pool_->allocate(static_descriptor_set_layout_->get());
+      std::vector<vk::DescriptorBindingFlags>{
+          vk::DescriptorBindingFlags{},
+          vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind,
+          vk::DescriptorBindingFlags{}, vk::DescriptorBindingFlags{}, vk::DescriptorBindingFlags{},
+          vk::DescriptorBindingFlags{}},
+      vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool);
+
+  for (auto& set: static_descriptor_sets_)
+  {
+    set = descriptor_pool_->allocate(static_descriptor_set_layout_->get());
+  }
 
   // -----------------------------------------------------------
   // CREATE FRAME RESOURCES
@@ -231,8 +358,22 @@ VulkanRenderer::VulkanRenderer(Window* window, ResourceManager& resource_manager
     submit_semaphores_.push_back(device_->get().createSemaphoreUnique(semaphore_create_info));
   }
 
+  ResizeObjectTable(kInitialObjectCapacity);
+
   RecreateFrameImages(width, height);
 
+  // -----------------------------------------------------------
+  // GEOMETRY
+  // -----------------------------------------------------------
+  geometry_heap_ = std::make_unique<VulkanGeometryHeap>(device_.get(), allocator_.get(), uploads_.get(),
+                                                        max_frames_in_flight_);
+  geometry_generation_ = geometry_heap_->Generation();
+
+  texture_streamer_ = std::make_unique<VulkanTextureStreamer>(device_.get(), allocator_.get(), uploads_.get(),
+                                                              max_frames_in_flight_, texture_capacity_,
+                                                              kDefaultTextureBudget);
+  MarkStaticDescriptorsDirty();
+
   // Transition render images
   {
     auto cmd = util::BeginSingleTimeCommandBuffer(*graphics_pool_);
@@ -246,83 +387,14 @@ VulkanRenderer::VulkanRenderer(Window* window, ResourceManager& resource_manager
     util::EndSingleTimeCommandBuffer(cmd, device_->GraphicsQueue(), *graphics_pool_);
   }
 
-  // -----------------------------------------------------------
-  // WRITE TO DESCRIPTOR SETS
-  // -----------------------------------------------------------
-  std::vector<vk::WriteDescriptorSet> writes;
-  writes.reserve(frames_.size() * 5);
-  std::vector<vk::DescriptorBufferInfo> buffer_infos;
-  buffer_infos.reserve(frames_.size() * 3);
-  std::vector<vk::DescriptorImageInfo> image_infos;
-  image_infos.reserve(frames_.size() * 2);
-
-  for (const auto& frame: frames_)
-  {
-    buffer_infos.push_back({.buffer = frame->IndirectBuffer()->get(), .offset = 0, .range = vk::WholeSize});
-
-    const vk::WriteDescriptorSet write{.dstSet = frame->DescriptorSet(),
-                                       .dstBinding = 0,
-                                       .dstArrayElement = 0,
-                                       .descriptorCount = 1,
-                                       .descriptorType = vk::DescriptorType::eStorageBuffer,
-                                       .pBufferInfo = &buffer_infos.back()};
-
-    writes.push_back(write);
-
-    buffer_infos.push_back({.buffer = frame->ObjectBuffer()->get(), .offset = 0, .range = vk::WholeSize});
-
-    const vk::WriteDescriptorSet write2{.dstSet = frame->DescriptorSet(),
-                                        .dstBinding = 1,
-                                        .dstArrayElement = 0,
-                                        .descriptorCount = 1,
-                                        .descriptorType = vk::DescriptorType::eStorageBuffer,
-                                        .pBufferInfo = &buffer_infos.back()};
-
-    writes.push_back(write2);
-
-    buffer_infos.push_back({.buffer = frame->DrawCount()->get(), .offset = 0, .range = vk::WholeSize});
-
-    const vk::WriteDescriptorSet write3{.dstSet = frame->DescriptorSet(),
-                                        .dstBinding = 2,
-                                        .dstArrayElement = 0,
-                                        .descriptorCount = 1,
-                                        .descriptorType = vk::DescriptorType::eStorageBuffer,
-                                        .pBufferInfo = &buffer_infos.back()};
-
-    writes.push_back(write3);
-
-    image_infos.push_back(vk::DescriptorImageInfo{.sampler = visibility_sampler_.get(),
-                                                  .imageView = frame->VisibilityImage()->view(),
-                                                  .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal});
-
-    const vk::WriteDescriptorSet write4{.dstSet = frame->DescriptorSet(),
-                                        .dstBinding = 3,
-                                        .dstArrayElement = 0,
-                                        .descriptorCount = 1,
-                                        .descriptorType = vk::DescriptorType::eCombinedImageSampler,
-                                        .pImageInfo = &image_infos.back()};
-
-    writes.push_back(write4);
-
-    image_infos.push_back(vk::DescriptorImageInfo{.sampler = VK_NULL_HANDLE,
-                                                  .imageView = frame->RenderImage()->view(),
-                                                  .imageLayout = vk::ImageLayout::eGeneral});
-
-    const vk::WriteDescriptorSet write5{.dstSet = frame->DescriptorSet(),
-                                        .dstBinding = 4,
-                                        .dstArrayElement = 0,
-                                        .descriptorCount = 1,
-                                        .descriptorType = vk::DescriptorType::eStorageImage,
-                                        .pImageInfo = &image_infos.back()};
-
-    writes.push_back(write5);
-  }
-
-  device_->get().updateDescriptorSets(writes.size(), writes.data(), 0, nullptr);
+  // buffers are written before each frame's first use, the images by RecreateFrameImages
+  MarkFrameDescriptorsDirty();
 
   // -----------------------------------------------------------
   // LOAD SHADERS
   // -----------------------------------------------------------
+  shader_reloader_ = std::make_unique<VulkanShaderReloader>(
+      device_->get(), jobs, files::GetAssetsPathRoot() / "engine/assets/shaders", max_frames_in_flight_);
 
   // pre pass
   const auto vert_code =
@@ -354,6 +426,14 @@ VulkanRenderer::VulkanRenderer(Window* window, ResourceManager& resource_manager
   const vk::PipelineShaderStageCreateInfo debug_line_frag_stage{
       .stage = vk::ShaderStageFlagBits::eFragment, .module = debug_line_frag_->get(), .pName = "main"};
 
+  // object table updates
+  const auto object_scatter_comp_code = resource_manager.CreateFromFile<ShaderResource>(
+      "engine/assets/shaders/object_scatter.comp.spv", ShaderResourceLoader{});
+  object_scatter_comp_ = std::make_unique<VulkanShader>(device_->get(), object_scatter_comp_code->code);
+
+  const vk::PipelineShaderStageCreateInfo object_scatter_comp_stage{
+      .stage = vk::ShaderStageFlagBits::eCompute, .module = object_scatter_comp_->get(), .pName = "main"};
+
   // culling
   const auto culling_comp_code =
       resource_manager.CreateFromFile<ShaderResource>("engine/assets/shaders/test.comp.spv", ShaderResourceLoader{});
@@ -362,6 +442,34 @@ VulkanRenderer::VulkanRenderer(Window* window, ResourceManager& resource_manager
   const vk::PipelineShaderStageCreateInfo culling_comp_stage{
       .stage = vk::ShaderStageFlagBits::eCompute, .module = culling_comp_->get(), .pName = "main"};
 
+  const auto cluster_culling_comp_code = resource_manager.CreateFromFile<ShaderResource>(
+      "engine/assets/shaders/cluster_culling.comp.spv", ShaderResourceLoader{});
+  cluster_culling_comp_ = std::make_unique<VulkanShader>(device_->get(), cluster_culling_comp_code->code);
+
+  const vk::PipelineShaderStageCreateInfo cluster_culling_comp_stage{
+      .stage = vk::ShaderStageFlagBits::eCompute, .module = cluster_culling_comp_->get(), .pName = "main"};
+
+  const auto depth_pyramid_comp_code = resource_manager.CreateFromFile<ShaderResource>(
+      "engine/assets/shaders/depth_pyramid.comp.spv", ShaderResourceLoader{});
+  depth_pyramid_comp_ = std::make_unique<VulkanShader>(device_->get(), depth_pyramid_comp_code->code);
+
+  const vk::PipelineShaderStageCreateInfo depth_pyramid_comp_stage{
+      .stage = vk::ShaderStageFlagBits::eCompute, .module = depth_pyramid_comp_->get(), .pName = "main"};
+
+  const auto instance_offsets_comp_code = resource_manager.CreateFromFile<ShaderResource>(
+      "engine/assets/shaders/instance_offsets.comp.spv", ShaderResourceLoader{});
+  instance_offsets_comp_ = std::make_unique<VulkanShader>(device_->get(), instance_offsets_comp_code->code);
+
+  const vk::PipelineShaderStageCreateInfo instance_offsets_comp_stage{
+      .stage = vk::ShaderStageFlagBits::eCompute, .module = instance_offsets_comp_->get(), .pName = "main"};
+
+  const auto instance_compaction_comp_code = resource_manager.CreateFromFile<ShaderResource>(
+      "engine/assets/shaders/instance_compaction.comp.spv", ShaderResourceLoader{});
+  instance_compaction_comp_ = std::make_unique<VulkanShader>(device_->get(), instance_compaction_comp_code->code);
+
+  const vk::PipelineShaderStageCreateInfo instance_compaction_comp_stage{
+      .stage = vk::ShaderStageFlagBits::eCompute, .module = instance_compaction_comp_->get(), .pName = "main"};
+
   // shading
   const auto shading_comp_code =
       resource_manager.CreateFromFile<ShaderResource>("engine/assets/shaders/shading.comp.spv", ShaderResourceLoader{});
@@ -404,13 +512,27 @@ VulkanRenderer::VulkanRenderer(Window* window, ResourceManager& resource_manager
     pipeline_layout_info.descriptor_sets.push_back(frame_descriptor_set_layout_->get());
 
     constexpr vk::PushConstantRange compute_push_constant_range{
-        .stageFlags = vk::ShaderStageFlagBits::eCompute, .offset = 0, .size = sizeof(ComputePushConstant)};
+        .stageFlags = vk::ShaderStageFlagBits::eCompute, .offset = 0, .size = sizeof(CullPushConstant)};
 
     pipeline_layout_info.push_constants.push_back(compute_push_constant_range);
 
     culling_pipeline_layout_ = std::make_unique<VulkanPipelineLayout>(device_->get(), pipeline_layout_info);
   }
 
+  // depth pyramid
+  {
+    PipelineLayoutInfo pipeline_layout_info{};
+
+    pipeline_layout_info.descriptor_sets.push_back(depth_pyramid_descriptor_set_layout_->get());
+
+    constexpr vk::PushConstantRange depth_pyramid_push_constant_range{
+        .stageFlags = vk::ShaderStageFlagBits::eCompute, .offset = 0, .size = sizeof(DepthPyramidPushConstant)};
+
+    pipeline_layout_info.push_constants.push_back(depth_pyramid_push_constant_range);
+
+    depth_pyramid_pipeline_layout_ = std::make_unique<VulkanPipelineLayout>(device_->get(), pipeline_layout_info);
+  }
+
   // shading
   {
     PipelineLayoutInfo pipeline_layout_info{};
@@ -429,28 +551,16 @@ VulkanRenderer::VulkanRenderer(Window* window, ResourceManager& resource_manager
   {
     GraphicsPipelineInfo pipeline_info{};
     pipeline_info.shader_stages = {vert_stage, frag_stage};
-    pipeline_info.color_attachment_formats = {vk::Format::eR32Uint};
+    pipeline_info.color_attachment_formats = {vk::Format::eR32G32Uint};
     pipeline_info.layout = pre_pass_pipeline_layout_->get();
     pipeline_info.color_blend_attachments = {{}};
     pipeline_info.front_face = vk::FrontFace::eClockwise;
 
     pipeline_info.depth_attachment_format = vk::Format::eD32Sfloat;
 
-    vk::VertexInputBindingDescription binding{};
-    binding.binding = 0;
-    binding.stride = sizeof(Vertex);
-    binding.inputRate = vk::VertexInputRate::eVertex;
-
-    vk::VertexInputAttributeDescription position_attr{};
-    position_attr.location = 0;
-    position_attr.binding = 0;
-    position_attr.format = vk::Format::eR32G32B32Sfloat;
-    position_attr.offset = offsetof(Vertex, position);
-
-    pipeline_info.vertex_bindings.push_back(binding);
-    pipeline_info.vertex_attributes.push_back(position_attr);
-
+    // no vertex input, meshes can have different vertex formats so the shader pulls and decodes them itself
     pre_pass_pipeline_ = std::make_unique<VulkanPipeline>(device_->get(), pipeline_info);
+    shader_reloader_->Track(&pre_pass_pipeline_, pipeline_info, {"test.vert", "test.frag"});
   }
 
   // debug line
@@ -484,6 +594,7 @@ VulkanRenderer::VulkanRenderer(Window* window, ResourceManager& resource_manager
     pipeline_info.vertex_attributes.push_back(color_attr);
 
     debug_line_pipeline_ = std::make_unique<VulkanPipeline>(device_->get(), pipeline_info);
+    shader_reloader_->Track(&debug_line_pipeline_, pipeline_info, {"debug_line.vert", "debug_line.frag"});
   }
 
   // culling
@@ -494,6 +605,55 @@ VulkanRenderer::VulkanRenderer(Window* window, ResourceManager& resource_manager
     };
 
     culling_pipeline_ = std::make_unique<VulkanPipeline>(device_->get(), culling_pipeline_info);
+    shader_reloader_->Track(&culling_pipeline_, culling_pipeline_info, {"test.comp"});
+
+    // same layout, the cluster stage reads what the object stage wrote
+    ComputePipelineInfo cluster_culling_pipeline_info{
+        .shader_stage = cluster_culling_comp_stage,
+        .layout = culling_pipeline_layout_->get(),
+    };
+
+    cluster_culling_pipeline_ = std::make_unique<VulkanPipeline>(device_->get(), cluster_culling_pipeline_info);
+    shader_reloader_->Track(&cluster_culling_pipeline_, cluster_culling_pipeline_info, {"cluster_culling.comp"});
+
+    // instanced variant of the cluster stage
+    ComputePipelineInfo instance_offsets_pipeline_info{
+        .shader_stage = instance_offsets_comp_stage,
+        .layout = culling_pipeline_layout_->get(),
+    };
+
+    instance_offsets_pipeline_ = std::make_unique<VulkanPipeline>(device_->get(), instance_offsets_pipeline_info);
+    shader_reloader_->Track(&instance_offsets_pipeline_, instance_offsets_pipeline_info, {"instance_offsets.comp"});
+
+    ComputePipelineInfo instance_compaction_pipeline_info{
+        .shader_stage = instance_compaction_comp_stage,
+        .layout = culling_pipeline_layout_->get(),
+    };
+
+    instance_compaction_pipeline_ =
+        std::make_unique<VulkanPipeline>(device_->get(), instance_compaction_pipeline_info);
+    shader_reloader_->Track(&instance_compaction_pipeline_, instance_compaction_pipeline_info,
+                            {"instance_compaction.comp"});
+
+    // runs before culling on the same sets, doesn't touch the push constant
+    ComputePipelineInfo object_scatter_pipeline_info{
+        .shader_stage = object_scatter_comp_stage,
+        .layout = culling_pipeline_layout_->get(),
+    };
+
+    object_scatter_pipeline_ = std::make_unique<VulkanPipeline>(device_->get(), object_scatter_pipeline_info);
+    shader_reloader_->Track(&object_scatter_pipeline_, object_scatter_pipeline_info, {"object_scatter.comp"});
+  }
+
+  // depth pyramid
+  {
+    ComputePipelineInfo depth_pyramid_pipeline_info{
+        .shader_stage = depth_pyramid_comp_stage,
+        .layout = depth_pyramid_pipeline_layout_->get(),
+    };
+
+    depth_pyramid_pipeline_ = std::make_unique<VulkanPipeline>(device_->get(), depth_pyramid_pipeline_info);
+    shader_reloader_->Track(&depth_pyramid_pipeline_, depth_pyramid_pipeline_info, {"depth_pyramid.comp"});
   }
 
   // shading
@@ -504,6 +664,7 @@ VulkanRenderer::VulkanRenderer(Window* window, ResourceManager& resource_manager
     };
 
     shading_pipeline_ = std::make_unique<VulkanPipeline>(device_->get(), shading_pipeline_info);
+    shader_reloader_->Track(&shading_pipeline_, shading_pipeline_info, {"shading.comp"});
   }
 
   // -----------------------------------------------------------
@@ -572,10 +733,61 @@ void VulkanRenderer::run(glm::mat4 world, float fov)
   const auto& frame = frames_.at(current_frame_);
 
   // -----------------------------------------------------------
-  // Upload render objects
+  // Swap in pipelines of edited shaders, nothing was recorded with the old ones yet
+  // -----------------------------------------------------------
+  shader_reloader_->Update();
+
+  // -----------------------------------------------------------
+  // Stream texture mips, release and compact geometry, release old textures and refresh this frame's static descriptors
+  // -----------------------------------------------------------
+  uploads_->Collect();
+  for (auto& retired: retired_buffers_)
+  {
+    --retired.frames_left;
+  }
+  std::erase_if(retired_buffers_, [](const RetiredBuffer& retired) { return retired.frames_left == 0; });
+  geometry_heap_->CollectRetired();
+  geometry_heap_->Compact(kCompactionBudget);
+  if (geometry_heap_->Generation() != geometry_generation_)
+  {
+    geometry_generation_ = geometry_heap_->Generation();
+    MarkStaticDescriptorsDirty();
+  }
+
+  // what this frame's shading pass asked for the last time it ran
+  frame->TextureFeedbackReadback()->Invalidate();
+  texture_streamer_->Update(std::span(frame->TextureFeedbackReadback()->GetMappedDataAs<const uint32_t>(),
+                                      frame->TextureFeedbackCapacity()));
+  texture_streamer_->CollectRetired();
+  for (const auto texture: texture_streamer_->TakeChanged())
+  {
+    for (auto& pending: pending_texture_descriptors_)
+    {
+      pending.push_back(texture);
+    }
+  }
+  WriteTextureDescriptors(current_frame_);
+
+  if (static_descriptors_dirty_.at(current_frame_))
+  {
+    WriteStaticDescriptors(current_frame_);
+  }
+
+  // -----------------------------------------------------------
+  // Grow the buffers that ran out of space
+  // -----------------------------------------------------------
+  GrowBuffers(*frame);
+
+  if (frame_descriptors_dirty_.at(current_frame_))
+  {
+    WriteFrameDescriptors(current_frame_);
+  }
+
+  // -----------------------------------------------------------
+  // Upload changed render objects
   // -----------------------------------------------------------
   ZoneNamedN(objectszone, "UploadObjects", true);
-  frame->ObjectBuffer()->WriteRange(render_objects_.data(), sizeof(RenderObject) * render_objects_.size());
+  const uint32_t object_update_count = WriteObjectUpdates(*frame);
 
   frame->DebugLineVertexBuffer()->WriteRange(debug_line_vertices_.data(),
                                              sizeof(DebugLineVertex) * debug_line_vertices_.size());
@@ -590,6 +802,35 @@ void VulkanRenderer::run(glm::mat4 world, float fov)
   const auto view_proj = projection * view;
   const auto frustum = ExtractFrustum(view_proj);
 
+  // instancing bins by mesh info, past kMaxMeshInfos there aren't enough counters
+  const auto mesh_info_count = static_cast<uint32_t>(geometry_heap_->MeshInfos().size());
+  const bool instanced = instanced_draws_ && mesh_info_count <= kMaxMeshInfos;
+
+  const CullData cull_data{
+      .view = view,
+      .proj = projection,
+      .frustum = frustum,
+      .camera_position = glm::vec3(world[3]),
+      .render_object_count = static_cast<uint32_t>(render_objects_.size()),
+      .max_object_count = frame->ObjectCapacity(),
+      .max_draw_count = frame->DrawCapacity(),
+      .lod_scale = static_cast<float>(swap_chain_->extent().height) / (2.0F * std::tan(glm::radians(fov) * 0.5F)),
+      .lod_threshold = lod_threshold_,
+      .depth_pyramid_size = glm::vec2(frame->DepthPyramid()->width(), frame->DepthPyramid()->height()),
+      .near_plane = kNearPlaneDistance,
+      .occlusion_culling = occlusion_culling_ ? 1U : 0U,
+      .mesh_info_count = mesh_info_count,
+      .max_mesh_info_count = kMaxMeshInfos,
+      .instanced_draws = instanced ? 1U : 0U,
+      .object_update_count = object_update_count,
+  };
+  frame->CullDataBuffer()->WriteRange(&cull_data, sizeof(CullData));
+
+  const PushConstant push_constant{
+      .view = view,
+      .proj = projection,
+  };
+
   // -----------------------------------------------------------
   // Begin command buffer
   // -----------------------------------------------------------
@@ -597,49 +838,61 @@ void VulkanRenderer::run(glm::mat4 world, float fov)
   constexpr vk::CommandBufferBeginInfo begin_info{};
   cmd.begin(begin_info);
 
+  // Culling runs in two phases. The first draws what was visible last frame and builds a depth pyramid from it, the
+  // second tests everything against that pyramid, draws what the first phase missed and records what's visible for
+  // the next frame.
+
   // -----------------------------------------------------------
-  // Compute pass - create indirect draw commands
+  // Compute pass - cull last frame's visible objects
   // -----------------------------------------------------------
   ZoneNamedN(computezone, "ComputePass", true);
   constexpr vk::DebugUtilsLabelEXT label_info1{.pLabelName = "FrustumGPUDrivenPass"};
   cmd.beginDebugUtilsLabelEXT(label_info1, instance_->getDynamicLoader());
 
-  cmd.fillBuffer(frame->DrawCount()->get(), 0, sizeof(uint32_t), 0);
+  RecordObjectTableResize(cmd);
+  geometry_heap_->RecordInfoUpdates(cmd);
+  RecordObjectUpdates(cmd, *frame, object_update_count);
 
-  vulkan_barriers::BufferBarrier(
-      cmd, vulkan_barriers::BufferInfo{.buffer = frame->DrawCount()->get(), .size = sizeof(uint32_t)},
-      vulkan_barriers::BufferUsageBit::CopyDestination, vulkan_barriers::BufferUsageBit::RWCompute);
+  cmd.fillBuffer(frame->DrawCount()->get(), 0, vk::WholeSize, 0);
 
-  const auto descriptor_sets = std::array{static_descriptor_set_, frame->DescriptorSet()};
+  // x counts the objects that survive the object stage, one cluster workgroup each
+  constexpr vk::DispatchIndirectCommand cluster_dispatch{.x = 0, .y = 1, .z = 1};
+  constexpr std::array<vk::DispatchIndirectCommand, kCullPhaseCount> cluster_dispatches{cluster_dispatch,
+                                                                                        cluster_dispatch};
+  cmd.updateBuffer(frame->ClusterDispatchBuffer()->get(), 0, sizeof(cluster_dispatches), cluster_dispatches.data());
 
-  cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, culling_pipeline_layout_->get(), 0, descriptor_sets.size(),
-                         descriptor_sets.data(), 0, nullptr);
+  vulkan_barriers::BufferBarrier(
+      cmd, vulkan_barriers::BufferInfo{.buffer = frame->DrawCount()->get(), .size = vk::WholeSize},
+      vulkan_barriers::BufferUsageBit::CopyDestination, vulkan_barriers::BufferUsageBit::RWCompute);
 
-  const auto render_objects_size = static_cast<uint32_t>(render_objects_.size());
-  const ComputePushConstant compute_push_constant{
-      .frustum = frustum,
-      .render_object_count = render_objects_size,
-  };
+  vulkan_barriers::BufferBarrier(
+      cmd, vulkan_barriers::BufferInfo{.buffer = frame->ClusterDispatchBuffer()->get(), .size = vk::WholeSize},
+      vulkan_barriers::BufferUsageBit::CopyDestination, vulkan_barriers::BufferUsageBit::RWCompute);
 
-  cmd.pushConstants(culling_pipeline_layout_->get(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(ComputePushConstant),
-                    &compute_push_constant);
+  if (instanced)
+  {
+    cmd.fillBuffer(frame->MeshInstanceBuffer()->get(), 0, vk::WholeSize, 0);
 
-  cmd.bindPipeline(vk::PipelineBindPoint::eCompute, culling_pipeline_->get());
-  const uint32_t workgroups = (render_objects_size + 255) / 256;
-  cmd.dispatch(workgroups, 1, 1);
+    vulkan_barriers::BufferBarrier(
+        cmd, vulkan_barriers::BufferInfo{.buffer = frame->MeshInstanceBuffer()->get(), .size = vk::WholeSize},
+        vulkan_barriers::BufferUsageBit::CopyDestination, vulkan_barriers::BufferUsageBit::RWCompute);
+  }
 
+  // written by the previous frame's second phase
   vulkan_barriers::BufferBarrier(
-      cmd, vulkan_barriers::BufferInfo{.buffer = frame->DrawCount()->get(), .size = sizeof(uint32_t)},
-      vulkan_barriers::BufferUsageBit::RWCompute, vulkan_barriers::BufferUsageBit::IndirectDraw);
+      cmd, vulkan_barriers::BufferInfo{.buffer = object_visibility_buffer_->get(), .size = vk::WholeSize},
+      vulkan_barriers::BufferUsageBit::RWCompute, vulkan_barriers::BufferUsageBit::RCompute);
 
-  vulkan_barriers::BufferBarrier(
-      cmd, vulkan_barriers::BufferInfo{.buffer = frame->IndirectBuffer()->get(), .size = vk::WholeSize},
-      vulkan_barriers::BufferUsageBit::RWCompute, vulkan_barriers::BufferUsageBit::IndirectDraw);
+  // the culling shader has the pyramid bound in both phases, it's rebuilt before the second one reads it
+  VulkanImage::TransitionImageLayout(frame->DepthPyramid()->get(), cmd, vk::ImageLayout::eUndefined,
+                                     vk::ImageLayout::eGeneral);
+
+  RecordCulling(cmd, *frame, 0, instanced);
 
   cmd.endDebugUtilsLabelEXT(instance_->getDynamicLoader());
 
   // -----------------------------------------------------------
-  // Graphics pass - render meshes visibility
+  // Graphics pass - render last frame's visible meshes
   // -----------------------------------------------------------
   ZoneNamedN(graphicsmesheszone, "MeshPass", true);
   constexpr vk::DebugUtilsLabelEXT label_info2{.pLabelName = "MeshPass"};
@@ -647,62 +900,68 @@ void VulkanRenderer::run(glm::mat4 world, float fov)
 
   VulkanImage::TransitionImageLayout(frame->VisibilityImage()->get(), cmd, vk::ImageLayout::eShaderReadOnlyOptimal,
                                      vk::ImageLayout::eColorAttachmentOptimal);
+  VulkanImage::TransitionImageLayout(frame->DepthImage()->get(), cmd, vk::ImageLayout::eUndefined,
+                                     vk::ImageLayout::eDepthAttachmentOptimal);
 
-  const vk::RenderingAttachmentInfo depth_attachment{
-      .imageView = frame->DepthImage()->view(),
-      .imageLayout = vk::ImageLayout::eDepthAttachmentOptimal,
-      .loadOp = vk::AttachmentLoadOp::eClear,
-      .storeOp = vk::AttachmentStoreOp::eDontCare,
-      .clearValue = vk::ClearValue{.depthStencil = {.depth = 1.0F, .stencil = 0}}};
+  RecordPrePass(cmd, *frame, 0, push_constant);
 
-  const vk::RenderingAttachmentInfo color_attachment{
-      .imageView = frame->VisibilityImage()->view(),
-      .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
-      .loadOp = vk::AttachmentLoadOp::eClear,
-      .storeOp = vk::AttachmentStoreOp::eStore,
-      .clearValue = vk::ClearValue{.color = vk::ClearColorValue{.uint32 = std::array{0U, 0U, 0U, 0U}}}};
+  cmd.endDebugUtilsLabelEXT(instance_->getDynamicLoader());
 
-  const vk::RenderingInfo render_info{
-      .renderArea = vk::Rect2D{.offset = {.x = 0, .y = 0}, .extent = swap_chain_->extent()},
-      .layerCount = 1,
-      .colorAttachmentCount = 1,
-      .pColorAttachments = &color_attachment,
-      .pDepthAttachment = &depth_attachment};
+  // -----------------------------------------------------------
+  // Compute pass - build depth pyramid
+  // -----------------------------------------------------------
+  ZoneNamedN(depthpyramidzone, "DepthPyramidPass", true);
+  constexpr vk::DebugUtilsLabelEXT label_info7{.pLabelName = "DepthPyramidPass"};
+  cmd.beginDebugUtilsLabelEXT(label_info7, instance_->getDynamicLoader());
 
-  cmd.beginRendering(render_info);
-  cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, pre_pass_pipeline_->get());
+  VulkanImage::TransitionImageLayout(frame->DepthImage()->get(), cmd, vk::ImageLayout::eDepthAttachmentOptimal,
+                                     vk::ImageLayout::eShaderReadOnlyOptimal);
 
-  cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pre_pass_pipeline_layout_->get(), 0, descriptor_sets.size(),
-                         descriptor_sets.data(), 0, nullptr);
+  RecordDepthPyramid(cmd, *frame);
 
-  const PushConstant push_constant{
-      .view = view,
-      .proj = projection,
-  };
+  cmd.endDebugUtilsLabelEXT(instance_->getDynamicLoader());
 
-  cmd.pushConstants(pre_pass_pipeline_layout_->get(), vk::ShaderStageFlagBits::eVertex, 0, sizeof(PushConstant),
-                    &push_constant);
-  constexpr vk::DeviceSize offset = 0;
-  const auto vertex_buffer = vertex_buffer_->get();
-  cmd.bindVertexBuffers(0, 1, &vertex_buffer, &offset);
-  const auto index_buffer = index_buffer_->get();
-  cmd.bindIndexBuffer(index_buffer, 0, vk::IndexType::eUint32);
+  // -----------------------------------------------------------
+  // Compute pass - occlusion cull against the depth pyramid
+  // -----------------------------------------------------------
+  ZoneNamedN(occlusionzone, "OcclusionPass", true);
+  constexpr vk::DebugUtilsLabelEXT label_info8{.pLabelName = "OcclusionGPUDrivenPass"};
+  cmd.beginDebugUtilsLabelEXT(label_info8, instance_->getDynamicLoader());
 
-  const vk::Viewport viewport{.x = 0.0F,
-                              .y = 0.0F,
-                              .width = static_cast<float>(swap_chain_->extent().width),
-                              .height = static_cast<float>(swap_chain_->extent().height),
-                              .minDepth = 0.0F,
-                              .maxDepth = 1.0F};
-  cmd.setViewport(0, 1, &viewport);
+  // the first phase read the flags this phase rewrites
+  vulkan_barriers::BufferBarrier(
+      cmd, vulkan_barriers::BufferInfo{.buffer = object_visibility_buffer_->get(), .size = vk::WholeSize},
+      vulkan_barriers::BufferUsageBit::RCompute, vulkan_barriers::BufferUsageBit::RWCompute);
 
-  const vk::Rect2D scissor{.offset = {.x = 0, .y = 0},
-                           .extent = {.width = swap_chain_->extent().width, .height = swap_chain_->extent().height}};
-  cmd.setScissor(0, 1, &scissor);
+  RecordCulling(cmd, *frame, 1, instanced);
 
-  cmd.drawIndexedIndirectCount(frame->IndirectBuffer()->get(), 0, frame->DrawCount()->get(), 0, render_objects_size,
-                               sizeof(vk::DrawIndexedIndirectCommand));
-  cmd.endRendering();
+  cmd.endDebugUtilsLabelEXT(instance_->getDynamicLoader());
+
+  // -----------------------------------------------------------
+  // Graphics pass - render newly visible meshes
+  // -----------------------------------------------------------
+  ZoneNamedN(graphicsoccludedzone, "LateMeshPass", true);
+  constexpr vk::DebugUtilsLabelEXT label_info9{.pLabelName = "LateMeshPass"};
+  cmd.beginDebugUtilsLabelEXT(label_info9, instance_->getDynamicLoader());
+
+  VulkanImage::TransitionImageLayout(frame->DepthImage()->get(), cmd, vk::ImageLayout::eShaderReadOnlyOptimal,
+                                     vk::ImageLayout::eDepthAttachmentOptimal);
+  VulkanImage::TransitionImageLayout(frame->VisibilityImage()->get(), cmd, vk::ImageLayout::eColorAttachmentOptimal,
+                                     vk::ImageLayout::eColorAttachmentOptimal);
+
+  RecordPrePass(cmd, *frame, 1, push_constant);
+
+  // read back the next time this frame comes up, it sizes the draw buffers
+  vulkan_barriers::BufferBarrier(
+      cmd, vulkan_barriers::BufferInfo{.buffer = frame->DrawCount()->get(), .size = vk::WholeSize},
+      vulkan_barriers::BufferUsageBit::IndirectDraw, vulkan_barriers::BufferUsageBit::CopySource);
+
+  const vk::BufferCopy draw_count_region{.srcOffset = 0, .dstOffset = 0, .size = sizeof(uint32_t) * kCullPhaseCount};
+  cmd.copyBuffer(frame->DrawCount()->get(), frame->DrawCountReadback()->get(), 1, &draw_count_region);
+
+  vulkan_barriers::BufferBarrier(
+      cmd, vulkan_barriers::BufferInfo{.buffer = frame->DrawCountReadback()->get(), .size = vk::WholeSize},
+      vulkan_barriers::BufferUsageBit::CopyDestination, vulkan_barriers::BufferUsageBit::HostRead);
 
   cmd.endDebugUtilsLabelEXT(instance_->getDynamicLoader());
 
@@ -719,15 +978,21 @@ void VulkanRenderer::run(glm::mat4 world, float fov)
   VulkanImage::TransitionImageLayout(frame->RenderImage()->get(), cmd, vk::ImageLayout::eTransferSrcOptimal,
                                      vk::ImageLayout::eGeneral);
 
+  // one requested mip per texture, min-ed by every pixel that sees it
+  cmd.fillBuffer(frame->TextureFeedback()->get(), 0, vk::WholeSize, UINT32_MAX);
+
   vulkan_barriers::BufferBarrier(
-      cmd, vulkan_barriers::BufferInfo{.buffer = vertex_buffer_->get(), .size = vk::WholeSize},
-      vulkan_barriers::BufferUsageBit::VertexOrIndex, vulkan_barriers::BufferUsageBit::RCompute);
+      cmd, vulkan_barriers::BufferInfo{.buffer = frame->TextureFeedback()->get(), .size = vk::WholeSize},
+      vulkan_barriers::BufferUsageBit::CopyDestination, vulkan_barriers::BufferUsageBit::RWCompute);
+
+  const auto index_buffer = geometry_heap_->IndexBuffer()->get();
 
   vulkan_barriers::BufferBarrier(
-      cmd, vulkan_barriers::BufferInfo{.buffer = index_buffer_->get(), .size = vk::WholeSize},
+      cmd, vulkan_barriers::BufferInfo{.buffer = index_buffer, .size = vk::WholeSize},
       vulkan_barriers::BufferUsageBit::VertexOrIndex, vulkan_barriers::BufferUsageBit::RCompute);
 
 
+  const auto descriptor_sets = std::array{static_descriptor_sets_.at(current_frame_), frame->DescriptorSet()};
   cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, shading_pipeline_layout_->get(), 0, descriptor_sets.size(),
                          descriptor_sets.data(), 0, nullptr);
   cmd.bindPipeline(vk::PipelineBindPoint::eCompute, shading_pipeline_->get());
@@ -739,12 +1004,21 @@ void VulkanRenderer::run(glm::mat4 world, float fov)
                                      vk::ImageLayout::eColorAttachmentOptimal);
 
   vulkan_barriers::BufferBarrier(
-      cmd, vulkan_barriers::BufferInfo{.buffer = vertex_buffer_->get(), .size = vk::WholeSize},
+      cmd, vulkan_barriers::BufferInfo{.buffer = index_buffer, .size = vk::WholeSize},
       vulkan_barriers::BufferUsageBit::RCompute, vulkan_barriers::BufferUsageBit::VertexOrIndex);
 
+  // read back the next time this frame comes up, it drives the texture streaming
   vulkan_barriers::BufferBarrier(
-      cmd, vulkan_barriers::BufferInfo{.buffer = index_buffer_->get(), .size = vk::WholeSize},
-      vulkan_barriers::BufferUsageBit::RCompute, vulkan_barriers::BufferUsageBit::VertexOrIndex);
+      cmd, vulkan_barriers::BufferInfo{.buffer = frame->TextureFeedback()->get(), .size = vk::WholeSize},
+      vulkan_barriers::BufferUsageBit::RWCompute, vulkan_barriers::BufferUsageBit::CopySource);
+
+  const vk::BufferCopy feedback_region{
+      .srcOffset = 0, .dstOffset = 0, .size = sizeof(uint32_t) * frame->TextureFeedbackCapacity()};
+  cmd.copyBuffer(frame->TextureFeedback()->get(), frame->TextureFeedbackReadback()->get(), 1, &feedback_region);
+
+  vulkan_barriers::BufferBarrier(
+      cmd, vulkan_barriers::BufferInfo{.buffer = frame->TextureFeedbackReadback()->get(), .size = vk::WholeSize},
+      vulkan_barriers::BufferUsageBit::CopyDestination, vulkan_barriers::BufferUsageBit::HostRead);
 
   cmd.endDebugUtilsLabelEXT(instance_->getDynamicLoader());
 
@@ -774,9 +1048,19 @@ void VulkanRenderer::run(glm::mat4 world, float fov)
 
   cmd.pushConstants(debug_line_pipeline_layout_->get(), vk::ShaderStageFlagBits::eVertex, 0, sizeof(PushConstant),
                     &push_constant);
+  constexpr vk::DeviceSize offset = 0;
   const auto debug_line_vertex_buffer = frame->DebugLineVertexBuffer()->get();
   cmd.bindVertexBuffers(0, 1, &debug_line_vertex_buffer, &offset);
 
+  const vk::Viewport viewport{.x = 0.0F,
+                              .y = 0.0F,
+                              .width = static_cast<float>(swap_chain_->extent().width),
+                              .height = static_cast<float>(swap_chain_->extent().height),
+                              .minDepth = 0.0F,
+                              .maxDepth = 1.0F};
+  const vk::Rect2D scissor{.offset = {.x = 0, .y = 0},
+                           .extent = {.width = swap_chain_->extent().width, .height = swap_chain_->extent().height}};
+
   cmd.setViewport(0, 1, &viewport);
 
   cmd.setScissor(0, 1, &scissor);
@@ -800,6 +1084,26 @@ void VulkanRenderer::run(glm::mat4 world, float fov)
   ImGui::NewFrame();
 
   ImGui::Begin("uhh");
+  ImGui::SliderFloat("LOD error (px)", &lod_threshold_, 0.0F, 16.0F);
+  ImGui::Checkbox("Occlusion culling", &occlusion_culling_);
+  ImGui::Checkbox("Instanced draws", &instanced_draws_);
+  ImGui::Text("Objects: %zu / %u", render_objects_.size(), object_capacity_);
+  ImGui::Text("Draws per phase: %u", frame->DrawCapacity());
+  ImGui::Text("Buffer growths: %u", buffer_growth_count_);
+  {
+    constexpr float kMiB = 1024.0F * 1024.0F;
+    const uint64_t vertex_bytes = geometry_heap_->VertexBytes();
+    const uint64_t saved_bytes = (geometry_heap_->VertexCount() * sizeof(Vertex)) - vertex_bytes;
+    ImGui::Text("Vertex data: %.1f MiB (%.1f MiB saved)", static_cast<float>(vertex_bytes) / kMiB,
+                static_cast<float>(saved_bytes) / kMiB);
+    ImGui::Text("Textures: %.1f / %.1f MiB resident (%.1f MiB with every mip)",
+                static_cast<float>(texture_streamer_->ResidentBytes()) / kMiB,
+                static_cast<float>(texture_streamer_->Budget()) / kMiB,
+                static_cast<float>(texture_streamer_->TotalBytes()) / kMiB);
+    ImGui::Text("Texture slots: %u / %u", texture_streamer_->LiveCount(), texture_streamer_->Capacity());
+    ImGui::Text("Staging: %.1f / %.1f MiB in flight", static_cast<float>(uploads_->StagingUsed()) / kMiB,
+                static_cast<float>(uploads_->StagingSize()) / kMiB);
+  }
   ImGui::End();
 
   ImGui::Render();
@@ -872,268 +1176,458 @@ void VulkanRenderer::run(glm::mat4 world, float fov)
   EndFrame(image_index);
 }
 
-uint32_t VulkanRenderer::AddMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
-                                 uint32_t first_index, int32_t vertex_offset, const glm::vec3& b_min,
-                                 const glm::vec3& b_max)
+void VulkanRenderer::ResizeObjectTable(const uint32_t capacity)
 {
-  const uint32_t mesh_id = mesh_infos_.size();
-  vertices_.insert(vertices_.end(), vertices.begin(), vertices.end());
-  indices_.insert(indices_.end(), indices.begin(), indices.end());
-  mesh_infos_.push_back(MeshInfo{.b_min = b_min,
-                                 .b_max = b_max,
-                                 .index_count = static_cast<uint32_t>(indices.size()),
-                                 .first_index = first_index,
-                                 .vertex_offset = vertex_offset});
-  return mesh_id;
+  ZoneScopedN("VulkanRenderer::ResizeObjectTable");
+
+  auto table = std::make_unique<VulkanBuffer>(
+      BufferInfo{.size = sizeof(RenderObject) * capacity,
+                 .usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc |
+                          vk::BufferUsageFlagBits::eTransferDst,
+                 .memoryUsage = VMA_MEMORY_USAGE_GPU_ONLY,
+                 .memoryFlags = {}},
+      allocator_->get(), device_.get());
+
+  auto visibility = std::make_unique<VulkanBuffer>(
+      BufferInfo{.size = sizeof(uint32_t) * capacity,
+                 .usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc |
+                          vk::BufferUsageFlagBits::eTransferDst,
+                 .memoryUsage = VMA_MEMORY_USAGE_GPU_ONLY,
+                 .memoryFlags = {}},
+      allocator_->get(), device_.get());
+
+  // The frame records the copy, the buffers it copies from stay around until the frames in flight are done with them.
+  // If the last resize wasn't recorded yet its buffers never got used, this one copies from where that one would have.
+  if (!object_table_copy_)
+  {
+    object_table_copy_ = ObjectTableCopy{
+        .table = object_table_.get(), .visibility = object_visibility_buffer_.get(), .capacity = object_capacity_};
+  }
+  if (object_table_)
+  {
+    retired_buffers_.push_back({.buffer = std::move(object_table_), .frames_left = max_frames_in_flight_});
+    retired_buffers_.push_back({.buffer = std::move(object_visibility_buffer_), .frames_left = max_frames_in_flight_});
+  }
+
+  object_table_ = std::move(table);
+  object_visibility_buffer_ = std::move(visibility);
+  object_capacity_ = capacity;
+  MarkFrameDescriptorsDirty();
 }
-uint32_t VulkanRenderer::AddTexture(std::span<const unsigned char> texture, int32_t width, int32_t height)
+
+void VulkanRenderer::RecordObjectTableResize(const vk::CommandBuffer cmd)
 {
-  const uint32_t idx = texture_infos_.size();
-  const uint32_t texture_id = textures_.size();
-  textures_.emplace_back(texture.begin(), texture.end());
-  texture_infos_.emplace_back(texture_id, width, height);
-  return idx;
+  if (!object_table_copy_)
+  {
+    return;
+  }
+  const auto copy = *std::exchange(object_table_copy_, std::nullopt);
+
+  const vulkan_barriers::BufferInfo table_info{.buffer = object_table_->get(), .size = vk::WholeSize};
+  const vulkan_barriers::BufferInfo visibility_info{.buffer = object_visibility_buffer_->get(), .size = vk::WholeSize};
+  const auto shader_usage = vulkan_barriers::BufferUsageBit::RGeometry | vulkan_barriers::BufferUsageBit::RCompute |
+                            vulkan_barriers::BufferUsageBit::RWCompute;
+
+  // new objects weren't visible last frame, they're drawn by the second culling phase
+  cmd.fillBuffer(object_visibility_buffer_->get(), 0, vk::WholeSize, 0);
+
+  if (copy.table != nullptr)
+  {
+    // the previous frame may still be culling with the old ones
+    vulkan_barriers::BufferBarrier(cmd, {.buffer = copy.table->get(), .size = vk::WholeSize}, shader_usage,
+                                   vulkan_barriers::BufferUsageBit::CopySource);
+    vulkan_barriers::BufferBarrier(cmd, {.buffer = copy.visibility->get(), .size = vk::WholeSize}, shader_usage,
+                                   vulkan_barriers::BufferUsageBit::CopySource);
+    vulkan_barriers::BufferBarrier(cmd, visibility_info, vulkan_barriers::BufferUsageBit::CopyDestination,
+                                   vulkan_barriers::BufferUsageBit::CopyDestination);
+
+    const vk::BufferCopy table_region{.srcOffset = 0, .dstOffset = 0, .size = sizeof(RenderObject) * copy.capacity};
+    cmd.copyBuffer(copy.table->get(), object_table_->get(), 1, &table_region);
+
+    const vk::BufferCopy visibility_region{.srcOffset = 0, .dstOffset = 0, .size = sizeof(uint32_t) * copy.capacity};
+    cmd.copyBuffer(copy.visibility->get(), object_visibility_buffer_->get(), 1, &visibility_region);
+  }
+
+  vulkan_barriers::BufferBarrier(cmd, table_info, vulkan_barriers::BufferUsageBit::CopyDestination, shader_usage);
+  vulkan_barriers::BufferBarrier(cmd, visibility_info, vulkan_barriers::BufferUsageBit::CopyDestination,
+                                 shader_usage);
 }
 
-void VulkanRenderer::RenderLine(const glm::vec3& point_a, const glm::vec3& point_b, const glm::vec3& color)
+void VulkanRenderer::GrowBuffers(VulkanFrame& frame)
 {
-  debug_line_vertices_.emplace_back(point_a, 0.0F, color, 0.0F);
-  debug_line_vertices_.emplace_back(point_b, 0.0F, color, 0.0F);
-}
+  ZoneScopedN("VulkanRenderer::GrowBuffers");
 
-void VulkanRenderer::ClearLines() { debug_line_vertices_.clear(); }
+  const auto grew = [this](const bool grown, const std::string_view name, const uint32_t capacity)
+  {
+    if (grown)
+    {
+      buffer_growth_count_++;
+      util::println("Grew {} to {}", name, capacity);
+    }
+    return grown;
+  };
 
-void VulkanRenderer::Upload()
+  const auto object_count = static_cast<uint32_t>(render_objects_.size());
+  if (object_count > object_capacity_)
+  {
+    ResizeObjectTable(std::max(object_count, object_capacity_ * 2));
+    grew(true, "object table", object_capacity_);
+  }
+
+  // The counts include the draws that didn't fit, a frame that ran out gets enough space the next time it comes up.
+  // Instanced draws give every visible object its own draw item.
+  frame.DrawCountReadback()->Invalidate();
+  const auto* draw_counts = frame.DrawCountReadback()->GetMappedDataAs<uint32_t>();
+  uint32_t draw_count = *std::max_element(draw_counts, draw_counts + kCullPhaseCount);
+  if (instanced_draws_)
+  {
+    draw_count = std::max(draw_count, object_count);
+  }
+
+  const auto update_count = static_cast<uint32_t>(dirty_object_slots_.size());
+  const auto line_count = static_cast<uint32_t>(debug_line_vertices_.size() / 2);
+
+  bool descriptors_dirty =
+      grew(frame.EnsureObjectCapacity(object_capacity_), "visible objects", frame.ObjectCapacity());
+  descriptors_dirty |= grew(frame.EnsureDrawCapacity(draw_count), "draws per phase", frame.DrawCapacity());
+  descriptors_dirty |=
+      grew(frame.EnsureObjectUpdateCapacity(update_count), "object updates", frame.ObjectUpdateCapacity());
+  descriptors_dirty |= grew(frame.EnsureTextureFeedbackCapacity(texture_streamer_->Count()), "texture feedback",
+                            frame.TextureFeedbackCapacity());
+  // only bound as a vertex buffer, no descriptor to rewrite
+  grew(frame.EnsureLineCapacity(line_count), "debug lines", frame.LineCapacity());
+
+  if (descriptors_dirty)
+  {
+    frame_descriptors_dirty_.at(current_frame_) = true;
+  }
+}
+
+uint32_t VulkanRenderer::WriteObjectUpdates(const VulkanFrame& frame)
 {
-  device_->WaitIdle(); // THIS BAD
-  // Destroy old buffers
-  if (vertex_buffer_)
+  const auto count =
+      static_cast<uint32_t>(std::min<size_t>(dirty_object_slots_.size(), frame.ObjectUpdateCapacity()));
+  if (count == 0)
   {
-    vertex_buffer_->Destroy();
-    vertex_buffer_ = nullptr;
+    return 0;
   }
 
-  if (index_buffer_)
+  // whatever doesn't fit stays dirty for the next frame
+  auto* updates = frame.ObjectUpdateBuffer()->GetMappedDataAs<ObjectUpdate>();
+  const size_t first = dirty_object_slots_.size() - count;
+  jobs_->ParallelFor(count, 4096,
+                     [&](const uint32_t begin, const uint32_t end)
+                     {
+                       for (uint32_t i = begin; i < end; i++)
+                       {
+                         const uint32_t slot = dirty_object_slots_.at(first + i);
+                         updates[i] = ObjectUpdate{.slot = slot, .object = render_objects_.at(slot)};
+                       }
+                     });
+  // vector<bool> packs bits, the flags can't be cleared from the batches
+  for (size_t i = first; i < dirty_object_slots_.size(); i++)
   {
-    index_buffer_->Destroy();
-    index_buffer_ = nullptr;
+    object_dirty_.at(dirty_object_slots_.at(i)) = false;
   }
+  dirty_object_slots_.resize(first);
+
+  return count;
+}
 
-  if (mesh_info_buffer_)
+void VulkanRenderer::RecordObjectUpdates(const vk::CommandBuffer cmd, const VulkanFrame& frame,
+                                         const uint32_t update_count) const
+{
+  if (update_count == 0)
   {
-    mesh_info_buffer_->Destroy();
-    mesh_info_buffer_ = nullptr;
+    return;
   }
 
-  texture_images_.clear();
+  const vulkan_barriers::BufferInfo object_table{.buffer = object_table_->get(), .size = vk::WholeSize};
 
-  // Create staging buffers and write the vertices, indices and mesh info to them.
-  const auto vertices_size = sizeof(Vertex) * vertices_.size();
-  const auto indices_size = sizeof(uint32_t) * indices_.size();
-  const auto meshes_size = sizeof(MeshInfo) * mesh_infos_.size();
-  const auto texture_infos_count = texture_infos_.size();
+  const auto readers = vulkan_barriers::BufferUsageBit::RGeometry | vulkan_barriers::BufferUsageBit::RCompute;
 
-  vertex_buffer_ = std::make_unique<VulkanBuffer>(
-      BufferInfo{.size = vertices_size,
-                 .usage = vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst |
-                          vk::BufferUsageFlagBits::eStorageBuffer,
-                 .memoryUsage = VMA_MEMORY_USAGE_GPU_ONLY,
-                 .memoryFlags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT},
-      allocator_->get(), device_.get());
+  // the previous frame's culling, pre pass and shading still read the table
+  vulkan_barriers::BufferBarrier(cmd, object_table, readers, vulkan_barriers::BufferUsageBit::RWCompute);
 
-  index_buffer_ = std::make_unique<VulkanBuffer>(
-      BufferInfo{.size = indices_size,
-                 .usage = vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst |
-                          vk::BufferUsageFlagBits::eStorageBuffer,
-                 .memoryUsage = VMA_MEMORY_USAGE_GPU_ONLY,
-                 .memoryFlags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT},
-      allocator_->get(), device_.get());
+  const auto descriptor_sets = std::array{static_descriptor_sets_.at(current_frame_), frame.DescriptorSet()};
+  cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, culling_pipeline_layout_->get(), 0, descriptor_sets.size(),
+                         descriptor_sets.data(), 0, nullptr);
+  cmd.bindPipeline(vk::PipelineBindPoint::eCompute, object_scatter_pipeline_->get());
+  cmd.dispatch((update_count + 255) / 256, 1, 1);
 
-  mesh_info_buffer_ = std::make_unique<VulkanBuffer>(
-      BufferInfo{.size = meshes_size,
-                 .usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
-                 .memoryUsage = VMA_MEMORY_USAGE_GPU_ONLY,
-                 .memoryFlags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT},
-      allocator_->get(), device_.get());
+  vulkan_barriers::BufferBarrier(cmd, object_table, vulkan_barriers::BufferUsageBit::RWCompute, readers);
+}
+
+void VulkanRenderer::RecordCulling(const vk::CommandBuffer cmd, const VulkanFrame& frame, const uint32_t phase,
+                                   const bool instanced) const
+{
+  const auto descriptor_sets = std::array{static_descriptor_sets_.at(current_frame_), frame.DescriptorSet()};
+
+  cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, culling_pipeline_layout_->get(), 0, descriptor_sets.size(),
+                         descriptor_sets.data(), 0, nullptr);
+
+  const CullPushConstant push_constant{.phase = phase};
+  cmd.pushConstants(culling_pipeline_layout_->get(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(CullPushConstant),
+                    &push_constant);
+
+  // object stage, frustum (and in the second phase occlusion) culls whole objects and lists the survivors
+  cmd.bindPipeline(vk::PipelineBindPoint::eCompute, culling_pipeline_->get());
+  const uint32_t workgroups = (static_cast<uint32_t>(render_objects_.size()) + 255) / 256;
+  cmd.dispatch(workgroups, 1, 1);
 
-  std::vector<std::unique_ptr<VulkanBuffer>> texture_staging_buffers;
-  texture_staging_buffers.reserve(texture_infos_count);
-  texture_images_.reserve(texture_infos_count);
-  for (const auto& texture_info: texture_infos_)
+  vulkan_barriers::BufferBarrier(
+      cmd, vulkan_barriers::BufferInfo{.buffer = frame.VisibleObjectBuffer()->get(), .size = vk::WholeSize},
+      vulkan_barriers::BufferUsageBit::RWCompute, vulkan_barriers::BufferUsageBit::RCompute);
+
+  vulkan_barriers::BufferBarrier(
+      cmd, vulkan_barriers::BufferInfo{.buffer = frame.ClusterDispatchBuffer()->get(), .size = vk::WholeSize},
+      vulkan_barriers::BufferUsageBit::RWCompute,
+      vulkan_barriers::BufferUsageBit::IndirectDraw | vulkan_barriers::BufferUsageBit::RCompute);
+
+  if (instanced)
+  {
+    // instance stage, the object stage counted the visible instances of every mesh lod. One thread group turns the
+    // counts into offsets and emits an instanced draw per mesh lod, then the visible objects are scattered into their
+    // mesh's range of draw items.
+    const vulkan_barriers::BufferInfo mesh_instances{.buffer = frame.MeshInstanceBuffer()->get(),
+                                                     .size = vk::WholeSize};
+    vulkan_barriers::BufferBarrier(cmd, mesh_instances, vulkan_barriers::BufferUsageBit::RWCompute,
+                                   vulkan_barriers::BufferUsageBit::RWCompute);
+
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, instance_offsets_pipeline_->get());
+    cmd.dispatch(1, 1, 1);
+
+    vulkan_barriers::BufferBarrier(cmd, mesh_instances, vulkan_barriers::BufferUsageBit::RWCompute,
+                                   vulkan_barriers::BufferUsageBit::RWCompute);
+
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, instance_compaction_pipeline_->get());
+    cmd.dispatch(workgroups, 1, 1);
+  } else
   {
-    texture_images_.emplace_back(std::make_unique<VulkanImage>(
-        ImageInfo{.width = static_cast<uint32_t>(texture_info.width),
-                  .height = static_cast<uint32_t>(texture_info.height),
-                  .format = vk::Format::eR8G8B8A8Srgb,
-                  .usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst,
-                  .aspect_flags = vk::ImageAspectFlagBits::eColor},
-        allocator_->get()));
-
-    const auto& staging_buffer = texture_staging_buffers.emplace_back(std::make_unique<VulkanBuffer>(
-        BufferInfo{
-            .size = static_cast<size_t>(texture_info.width * texture_info.height * 4),
-            .usage = vk::BufferUsageFlagBits::eTransferSrc,
-            .memoryUsage = VMA_MEMORY_USAGE_CPU_ONLY,
-            .memoryFlags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT},
-        allocator_->get(), device_.get()));
-    staging_buffer->Write(textures_.at(texture_info.texture_id).data());
+    // cluster stage, frustum and cone culls the meshlets of the visible objects and emits one draw per meshlet
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, cluster_culling_pipeline_->get());
+    cmd.dispatchIndirect(frame.ClusterDispatchBuffer()->get(), phase * sizeof(vk::DispatchIndirectCommand));
   }
 
-  auto staging_vertex_buffer =
-      VulkanBuffer(BufferInfo{.size = vertices_size,
-                              .usage = vk::BufferUsageFlagBits::eTransferSrc,
-                              .memoryUsage = VMA_MEMORY_USAGE_AUTO,
-                              .memoryFlags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
-                                             VMA_ALLOCATION_CREATE_MAPPED_BIT},
-                   allocator_->get(), device_.get());
-  staging_vertex_buffer.Write(vertices_.data());
-
-  auto staging_index_buffer =
-      VulkanBuffer(BufferInfo{.size = indices_size,
-                              .usage = vk::BufferUsageFlagBits::eTransferSrc,
-                              .memoryUsage = VMA_MEMORY_USAGE_AUTO,
-                              .memoryFlags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
-                                             VMA_ALLOCATION_CREATE_MAPPED_BIT},
-                   allocator_->get(), device_.get());
-  staging_index_buffer.Write(indices_.data());
-
-  auto staging_mesh_info_buffer =
-      VulkanBuffer(BufferInfo{.size = meshes_size,
-                              .usage = vk::BufferUsageFlagBits::eTransferSrc,
-                              .memoryUsage = VMA_MEMORY_USAGE_AUTO,
-                              .memoryFlags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
-                                             VMA_ALLOCATION_CREATE_MAPPED_BIT},
-                   allocator_->get(), device_.get());
-  staging_mesh_info_buffer.Write(mesh_infos_.data());
-
-
-  // Copy staging buffers to real buffers
-  const auto cmd = util::BeginSingleTimeCommandBuffer(*transfer_pool_);
-
-  vk::BufferCopy vertex_copy_region = {};
-  vertex_copy_region.srcOffset = 0;
-  vertex_copy_region.dstOffset = 0;
-  vertex_copy_region.size = vertices_size;
-  cmd.copyBuffer(staging_vertex_buffer.get(), vertex_buffer_->get(), 1, &vertex_copy_region);
-
-  vk::BufferCopy index_copy_region = {};
-  index_copy_region.srcOffset = 0;
-  index_copy_region.dstOffset = 0;
-  index_copy_region.size = indices_size;
-  cmd.copyBuffer(staging_index_buffer.get(), index_buffer_->get(), 1, &index_copy_region);
-
-  vk::BufferCopy mesh_info_copy_region = {};
-  mesh_info_copy_region.srcOffset = 0;
-  mesh_info_copy_region.dstOffset = 0;
-  mesh_info_copy_region.size = meshes_size;
-  cmd.copyBuffer(staging_mesh_info_buffer.get(), mesh_info_buffer_->get(), 1, &mesh_info_copy_region);
-
-  util::EndSingleTimeCommandBuffer(cmd, device_->TransferQueue(), *transfer_pool_);
-
-  const auto gcmd = util::BeginSingleTimeCommandBuffer(*graphics_pool_);
-  for (size_t i{}; i < texture_infos_count; i++)
-  {
-    const auto& staging = texture_staging_buffers.at(i);
-    const auto& image = texture_images_.at(i);
-    const auto& info = texture_infos_.at(i);
+  vulkan_barriers::BufferBarrier(
+      cmd, vulkan_barriers::BufferInfo{.buffer = frame.DrawCount()->get(), .size = vk::WholeSize},
+      vulkan_barriers::BufferUsageBit::RWCompute, vulkan_barriers::BufferUsageBit::IndirectDraw);
+
+  vulkan_barriers::BufferBarrier(
+      cmd, vulkan_barriers::BufferInfo{.buffer = frame.IndirectBuffer()->get(), .size = vk::WholeSize},
+      vulkan_barriers::BufferUsageBit::RWCompute, vulkan_barriers::BufferUsageBit::IndirectDraw);
 
-    image->TransitionLayout(gcmd, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
-    vk::BufferImageCopy texture_image_copy_region = {};
-    texture_image_copy_region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-    texture_image_copy_region.imageSubresource.layerCount = 1;
-    texture_image_copy_region.imageExtent = vk::Extent3D{
-        .width = static_cast<uint32_t>(info.width), .height = static_cast<uint32_t>(info.height), .depth = 1};
+  vulkan_barriers::BufferBarrier(
+      cmd, vulkan_barriers::BufferInfo{.buffer = frame.DrawItemBuffer()->get(), .size = vk::WholeSize},
+      vulkan_barriers::BufferUsageBit::RWCompute,
+      vulkan_barriers::BufferUsageBit::RGeometry | vulkan_barriers::BufferUsageBit::RCompute);
+}
 
-    gcmd.copyBufferToImage(staging->get(), image->get(), vk::ImageLayout::eTransferDstOptimal, 1,
-                           &texture_image_copy_region);
+void VulkanRenderer::RecordPrePass(const vk::CommandBuffer cmd, const VulkanFrame& frame, const uint32_t phase,
+                                   const PushConstant& push_constant) const
+{
+  // the second phase draws on top of the first
+  const auto load_op = phase == 0 ? vk::AttachmentLoadOp::eClear : vk::AttachmentLoadOp::eLoad;
 
-    image->TransitionLayout(gcmd, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
-  }
+  const vk::RenderingAttachmentInfo depth_attachment{
+      .imageView = frame.DepthImage()->view(),
+      .imageLayout = vk::ImageLayout::eDepthAttachmentOptimal,
+      .loadOp = load_op,
+      .storeOp = phase == 0 ? vk::AttachmentStoreOp::eStore : vk::AttachmentStoreOp::eDontCare,
+      .clearValue = vk::ClearValue{.depthStencil = {.depth = 1.0F, .stencil = 0}}};
+
+  const vk::RenderingAttachmentInfo color_attachment{
+      .imageView = frame.VisibilityImage()->view(),
+      .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+      .loadOp = load_op,
+      .storeOp = vk::AttachmentStoreOp::eStore,
+      .clearValue = vk::ClearValue{.color = vk::ClearColorValue{.uint32 = std::array{UINT32_MAX, 0U, 0U, 0U}}}};
 
-  vulkan_barriers::BufferBarrier(gcmd,
-                                 vulkan_barriers::BufferInfo{.buffer = vertex_buffer_->get(), .size = vk::WholeSize},
-                                 vulkan_barriers::BufferUsageBit::None, vulkan_barriers::BufferUsageBit::VertexOrIndex);
+  const vk::RenderingInfo render_info{
+      .renderArea = vk::Rect2D{.offset = {.x = 0, .y = 0}, .extent = swap_chain_->extent()},
+      .layerCount = 1,
+      .colorAttachmentCount = 1,
+      .pColorAttachments = &color_attachment,
+      .pDepthAttachment = &depth_attachment};
 
-  vulkan_barriers::BufferBarrier(gcmd,
-                                 vulkan_barriers::BufferInfo{.buffer = index_buffer_->get(), .size = vk::WholeSize},
-                                 vulkan_barriers::BufferUsageBit::None, vulkan_barriers::BufferUsageBit::VertexOrIndex);
-  util::EndSingleTimeCommandBuffer(gcmd, device_->GraphicsQueue(), *graphics_pool_);
+  cmd.beginRendering(render_info);
+  cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, pre_pass_pipeline_->get());
 
-  // Update the mesh info descriptor set
+  const auto descriptor_sets = std::array{static_descriptor_sets_.at(current_frame_), frame.DescriptorSet()};
+  cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pre_pass_pipeline_layout_->get(), 0, descriptor_sets.size(),
+                         descriptor_sets.data(), 0, nullptr);
 
-  std::vector<vk::WriteDescriptorSet> writes;
-  writes.reserve(4);
-  std::vector<vk::DescriptorBufferInfo> buffer_infos;
-  buffer_infos.reserve(3);
-  std::vector<vk::DescriptorImageInfo> image_infos;
-  image_infos.reserve(texture_images_.size());
+  cmd.pushConstants(pre_pass_pipeline_layout_->get(), vk::ShaderStageFlagBits::eVertex, 0, sizeof(PushConstant),
+                    &push_constant);
+  cmd.bindIndexBuffer(geometry_heap_->IndexBuffer()->get(), 0, vk::IndexType::eUint32);
 
-  buffer_infos.push_back({.buffer = mesh_info_buffer_->get(), .offset = 0, .range = vk::WholeSize});
+  const vk::Viewport viewport{.x = 0.0F,
+                              .y = 0.0F,
+                              .width = static_cast<float>(swap_chain_->extent().width),
+                              .height = static_cast<float>(swap_chain_->extent().height),
+                              .minDepth = 0.0F,
+                              .maxDepth = 1.0F};
+  cmd.setViewport(0, 1, &viewport);
 
-  writes.push_back({.dstSet = static_descriptor_set_,
-                    .dstBinding = 0,
-                    .dstArrayElement = 0,
-                    .descriptorCount = 1,
-                    .descriptorType = vk::DescriptorType::eStorageBuffer,
-                    .pBufferInfo = &buffer_infos.back()});
+  const vk::Rect2D scissor{.offset = {.x = 0, .y = 0},
+                           .extent = {.width = swap_chain_->extent().width, .height = swap_chain_->extent().height}};
+  cmd.setScissor(0, 1, &scissor);
 
-  for (const auto& img: texture_images_)
-  {
-    image_infos.push_back({.sampler = texture_sampler_.get(),
-                           .imageView = img->view(),
-                           .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal});
-  }
+  cmd.drawIndexedIndirectCount(frame.IndirectBuffer()->get(),
+                               phase * frame.DrawCapacity() * sizeof(vk::DrawIndexedIndirectCommand),
+                               frame.DrawCount()->get(), phase * sizeof(uint32_t), frame.DrawCapacity(),
+                               sizeof(vk::DrawIndexedIndirectCommand));
+  cmd.endRendering();
+}
 
-  if (!image_infos.empty())
+void VulkanRenderer::RecordDepthPyramid(const vk::CommandBuffer cmd, const VulkanFrame& frame) const
+{
+  const auto* pyramid = frame.DepthPyramid();
+  const auto& descriptor_sets = depth_pyramid_descriptor_sets_.at(current_frame_);
+
+  cmd.bindPipeline(vk::PipelineBindPoint::eCompute, depth_pyramid_pipeline_->get());
+
+  for (uint32_t level{}; level < pyramid->MipLevels(); level++)
   {
-    writes.push_back({.dstSet = static_descriptor_set_,
-                      .dstBinding = 1,
-                      .dstArrayElement = 0,
-                      .descriptorCount = static_cast<uint32_t>(image_infos.size()),
-                      .descriptorType = vk::DescriptorType::eCombinedImageSampler,
-                      .pImageInfo = image_infos.data()});
+    const uint32_t width = std::max(pyramid->width() >> level, 1U);
+    const uint32_t height = std::max(pyramid->height() >> level, 1U);
+
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, depth_pyramid_pipeline_layout_->get(), 0, 1,
+                           &descriptor_sets.at(level), 0, nullptr);
+
+    const DepthPyramidPushConstant push_constant{.image_size = glm::vec2(width, height)};
+    cmd.pushConstants(depth_pyramid_pipeline_layout_->get(), vk::ShaderStageFlagBits::eCompute, 0,
+                      sizeof(DepthPyramidPushConstant), &push_constant);
+
+    cmd.dispatch((width + 15) / 16, (height + 15) / 16, 1);
+
+    // the next level (or the second culling phase) reads this one
+    VulkanImage::TransitionImageLayout(pyramid->get(), cmd, vk::ImageLayout::eGeneral, vk::ImageLayout::eGeneral);
   }
+}
 
-  buffer_infos.push_back({.buffer = vertex_buffer_->get(), .offset = 0, .range = vk::WholeSize});
+uint32_t VulkanRenderer::AddMesh(const std::span<const std::byte> positions,
+                                 const std::span<const std::byte> attributes, const VertexFormat vertex_format,
+                                 const std::span<const uint32_t> indices, const std::span<const Meshlet> meshlets,
+                                 const std::span<const MeshLod> lods, const glm::vec3& b_min, const glm::vec3& b_max)
+{
+  return geometry_heap_->AddMesh(positions, attributes, vertex_format, indices, meshlets, lods, b_min, b_max);
+}
 
-  writes.push_back({.dstSet = static_descriptor_set_,
-                    .dstBinding = 2,
-                    .dstArrayElement = 0,
-                    .descriptorCount = 1,
-                    .descriptorType = vk::DescriptorType::eStorageBuffer,
-                    .pBufferInfo = &buffer_infos.back()});
+uint32_t VulkanRenderer::AddTexture(const TextureFormat format, const std::span<const TextureMip> mips,
+                                    const std::span<const std::byte> data, std::shared_ptr<const void> owner)
+{
+  return texture_streamer_->Add(format, mips, data, std::move(owner));
+}
 
-  buffer_infos.push_back({.buffer = index_buffer_->get(), .offset = 0, .range = vk::WholeSize});
+void VulkanRenderer::RemoveMesh(const uint32_t mesh_id) { geometry_heap_->RemoveMesh(mesh_id); }
 
-  writes.push_back({.dstSet = static_descriptor_set_,
-                    .dstBinding = 3,
-                    .dstArrayElement = 0,
-                    .descriptorCount = 1,
-                    .descriptorType = vk::DescriptorType::eStorageBuffer,
-                    .pBufferInfo = &buffer_infos.back()});
+void VulkanRenderer::RemoveTexture(const uint32_t texture) { texture_streamer_->Remove(texture); }
 
-  device_->get().updateDescriptorSets(writes.size(), writes.data(), 0, nullptr);
+bool VulkanRenderer::SupportsBlockCompression() const { return device_->SupportsBlockCompression(); }
+
+void VulkanRenderer::RenderLine(const glm::vec3& point_a, const glm::vec3& point_b, const glm::vec3& color)
+{
+  debug_line_vertices_.emplace_back(point_a, 0.0F, color, 0.0F);
+  debug_line_vertices_.emplace_back(point_b, 0.0F, color, 0.0F);
+}
+
+void VulkanRenderer::ClearLines() { debug_line_vertices_.clear(); }
+
+void VulkanRenderer::Upload()
+{
+  // the descriptors of the new images are written at the start of the next frame
+  texture_streamer_->Upload();
+}
+
+void VulkanRenderer::SetTextureBudget(const uint64_t bytes) { texture_streamer_->SetBudget(bytes); }
+
+uint32_t VulkanRenderer::CreateObject(const glm::mat4& model, const uint32_t mesh_id, const int32_t texture_id)
+{
+  const uint32_t slot = AllocateObjectSlot();
+  UpdateObject(slot, model, mesh_id, texture_id);
+  return slot;
+}
+
+void VulkanRenderer::UpdateObject(const uint32_t slot, const glm::mat4& model, const uint32_t mesh_id,
+                                  const int32_t texture_id)
+{
+  WriteObject(slot, model, mesh_id, texture_id);
+  MarkObjectDirty(slot);
+}
+
+void VulkanRenderer::CreateObjects(const std::span<uint32_t> slots)
+{
+  // one reallocation instead of one per doubling
+  const size_t fresh = slots.size() - std::min(slots.size(), free_object_slots_.size());
+  render_objects_.reserve(render_objects_.size() + fresh);
+  object_dirty_.reserve(object_dirty_.size() + fresh);
+  dirty_object_slots_.reserve(dirty_object_slots_.size() + slots.size());
+
+  std::ranges::generate(slots, [this] { return AllocateObjectSlot(); });
+}
+
+void VulkanRenderer::WriteObject(const uint32_t slot, const glm::mat4& model, const uint32_t mesh_id,
+                                 const int32_t texture_id)
+{
+  render_objects_.at(slot) = RenderObject{.model = model, .mesh_id = mesh_id, .texture_id = texture_id, .pad = {}};
+}
+
+void VulkanRenderer::CommitObjects(const std::span<const uint32_t> slots)
+{
+  dirty_object_slots_.reserve(dirty_object_slots_.size() + slots.size());
+  for (const auto slot: slots)
+  {
+    MarkObjectDirty(slot);
+  }
+}
+
+uint32_t VulkanRenderer::AllocateObjectSlot()
+{
+  if (!free_object_slots_.empty())
+  {
+    const uint32_t slot = free_object_slots_.back();
+    free_object_slots_.pop_back();
+    return slot;
+  }
 
-  device_->WaitIdle(); // THIS BAD
+  // the table grows at the start of the next frame
+  const auto slot = static_cast<uint32_t>(render_objects_.size());
+  render_objects_.push_back(
+      RenderObject{.model = glm::mat4(1.0F), .mesh_id = kInvalidMeshId, .texture_id = -1, .pad = {}});
+  object_dirty_.push_back(false);
+  return slot;
 }
 
-void VulkanRenderer::RenderMesh(const glm::mat4& model, const uint32_t mesh_id, int32_t texture_id)
+void VulkanRenderer::DestroyObject(const uint32_t slot)
 {
-  render_objects_.emplace_back(model, mesh_id, texture_id);
+  // the slot stays below the high water mark, culling skips it until it's reused
+  render_objects_.at(slot) =
+      RenderObject{.model = glm::mat4(1.0F), .mesh_id = kInvalidMeshId, .texture_id = -1, .pad = {}};
+  MarkObjectDirty(slot);
+  free_object_slots_.push_back(slot);
 }
 
-void VulkanRenderer::ClearMeshes(const uint32_t reserve)
+void VulkanRenderer::MarkObjectDirty(const uint32_t slot)
 {
-  render_objects_.clear();
-  render_objects_.reserve(reserve);
+  if (!object_dirty_.at(slot))
+  {
+    object_dirty_.at(slot) = true;
+    dirty_object_slots_.push_back(slot);
+  }
 }
 
-int32_t VulkanRenderer::GetVertexCount() const { return static_cast<int32_t>(vertices_.size()); }
-uint32_t VulkanRenderer::GetIndexCount() const { return indices_.size(); }
+int32_t VulkanRenderer::GetVertexCount() const { return static_cast<int32_t>(geometry_heap_->VertexCount()); }
+uint32_t VulkanRenderer::GetIndexCount() const { return static_cast<uint32_t>(geometry_heap_->IndexCount()); }
 
 void VulkanRenderer::OnMeshResourceDestroyed(const MeshResource& resource)
 {
-  util::println("Yo: {}", resource.renderer_id);
+  // the last handle is gone, so are the objects that drew it. Both free their memory once the gpu is past them.
+  RemoveMesh(resource.renderer_id);
+  if (resource.texture_id >= 0)
+  {
+    RemoveTexture(static_cast<uint32_t>(resource.texture_id));
+  }
 }
 
 std::optional<uint32_t> VulkanRenderer::BeginFrame() const
@@ -1165,16 +1659,25 @@ auto VulkanRenderer::EndFrame(const uint32_t image_index) -> void
   ZoneScopedN("VulkanRenderer::endFrame");
   const auto& frame = frames_.at(current_frame_);
 
-  const vk::SemaphoreSubmitInfo wait_semaphore{.semaphore = frame->ImageAvailable(),
-                                               .stageMask = vk::PipelineStageFlagBits2::eColorAttachmentOutput};
+  // everything recorded since the last frame goes out first, this frame may need some of it
+  uploads_->Submit();
+
+  std::array wait_semaphores{
+      vk::SemaphoreSubmitInfo{.semaphore = frame->ImageAvailable(),
+                              .stageMask = vk::PipelineStageFlagBits2::eColorAttachmentOutput},
+      vk::SemaphoreSubmitInfo{.semaphore = uploads_->Semaphore(),
+                              .value = uploads_->RequiredValue(),
+                              .stageMask = vk::PipelineStageFlagBits2::eAllCommands}};
+  // streamed mips don't hold the frame up, only new meshes and textures and swapped in images do
+  const uint32_t wait_count = uploads_->RequiredValue() > 0 ? 2 : 1;
 
   const vk::SemaphoreSubmitInfo signal_semaphore{.semaphore = submit_semaphores_.at(image_index).get(),
                                                  .stageMask = vk::PipelineStageFlagBits2::eAllCommands};
 
   const vk::CommandBufferSubmitInfo cmd_info{.commandBuffer = frame->GraphicsCmd()};
 
-  const vk::SubmitInfo2 submit_info{.waitSemaphoreInfoCount = 1,
-                                    .pWaitSemaphoreInfos = &wait_semaphore,
+  const vk::SubmitInfo2 submit_info{.waitSemaphoreInfoCount = wait_count,
+                                    .pWaitSemaphoreInfos = wait_semaphores.data(),
                                     .commandBufferInfoCount = 1,
                                     .pCommandBufferInfos = &cmd_info,
                                     .signalSemaphoreInfoCount = 1,
@@ -1209,12 +1712,15 @@ void VulkanRenderer::RecreateSwapChain()
 
 void VulkanRenderer::RecreateFrameImages(const uint32_t width, const uint32_t height) const
 {
+  // visibility, render and pyramid image per frame, plus an input and output image per pyramid level
+  const size_t writes_per_frame = 3 + 2 * kMaxDepthPyramidLevels;
   std::vector<vk::WriteDescriptorSet> writes;
-  writes.reserve(frames_.size() * 2);
+  writes.reserve(frames_.size() * writes_per_frame);
   std::vector<vk::DescriptorImageInfo> image_infos;
-  image_infos.reserve(frames_.size() * 2);
-  for (const auto& frame: frames_)
+  image_infos.reserve(frames_.size() * writes_per_frame);
+  for (size_t frame_index{}; frame_index < frames_.size(); frame_index++)
   {
+    const auto& frame = frames_.at(frame_index);
     frame->RecreateFrameImages(width, height);
 
     image_infos.push_back(vk::DescriptorImageInfo{.sampler = visibility_sampler_.get(),
@@ -1239,7 +1745,192 @@ void VulkanRenderer::RecreateFrameImages(const uint32_t width, const uint32_t he
                                               .descriptorType = vk::DescriptorType::eStorageImage,
                                               .pImageInfo = &image_infos.back()};
     writes.push_back(render_write);
+
+    const auto* pyramid = frame->DepthPyramid();
+    image_infos.push_back(vk::DescriptorImageInfo{.sampler = depth_pyramid_sampler_.get(),
+                                                  .imageView = pyramid->view(),
+                                                  .imageLayout = vk::ImageLayout::eGeneral});
+    writes.push_back({.dstSet = frame->DescriptorSet(),
+                      .dstBinding = 10,
+                      .dstArrayElement = 0,
+                      .descriptorCount = 1,
+                      .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+                      .pImageInfo = &image_infos.back()});
+
+    const auto& pyramid_sets = depth_pyramid_descriptor_sets_.at(frame_index);
+    for (uint32_t level{}; level < pyramid->MipLevels(); level++)
+    {
+      // the first level reduces the depth image itself
+      image_infos.push_back(level == 0 ? vk::DescriptorImageInfo{.sampler = depth_pyramid_sampler_.get(),
+                                                                 .imageView = frame->DepthImage()->view(),
+                                                                 .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal}
+                                       : vk::DescriptorImageInfo{.sampler = depth_pyramid_sampler_.get(),
+                                                                 .imageView = pyramid->MipView(level - 1),
+                                                                 .imageLayout = vk::ImageLayout::eGeneral});
+      writes.push_back({.dstSet = pyramid_sets.at(level),
+                        .dstBinding = 0,
+                        .dstArrayElement = 0,
+                        .descriptorCount = 1,
+                        .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+                        .pImageInfo = &image_infos.back()});
+
+      image_infos.push_back(vk::DescriptorImageInfo{.sampler = VK_NULL_HANDLE,
+                                                    .imageView = pyramid->MipView(level),
+                                                    .imageLayout = vk::ImageLayout::eGeneral});
+      writes.push_back({.dstSet = pyramid_sets.at(level),
+                        .dstBinding = 1,
+                        .dstArrayElement = 0,
+                        .descriptorCount = 1,
+                        .descriptorType = vk::DescriptorType::eStorageImage,
+                        .pImageInfo = &image_infos.back()});
+    }
   }
 
   device_->get().updateDescriptorSets(writes.size(), writes.data(), 0, nullptr);
 }
+
+void VulkanRenderer::MarkStaticDescriptorsDirty() { static_descriptors_dirty_.fill(true); }
+
+void VulkanRenderer::MarkFrameDescriptorsDirty() { frame_descriptors_dirty_.fill(true); }
+
+void VulkanRenderer::WriteFrameDescriptors(const uint32_t frame_index)
+{
+  const auto& frame = frames_.at(frame_index);
+
+  const auto buffers = std::array{std::pair{0U, frame->IndirectBuffer()},
+                                  std::pair{1U, object_table_.get()},
+                                  std::pair{2U, frame->DrawCount()},
+                                  std::pair{5U, frame->VisibleObjectBuffer()},
+                                  std::pair{6U, frame->ClusterDispatchBuffer()},
+                                  std::pair{7U, frame->DrawItemBuffer()},
+                                  std::pair{8U, frame->CullDataBuffer()},
+                                  std::pair{9U, object_visibility_buffer_.get()},
+                                  std::pair{11U, frame->MeshInstanceBuffer()},
+                                  std::pair{12U, frame->ObjectUpdateBuffer()},
+                                  std::pair{13U, frame->TextureFeedback()}};
+
+  std::vector<vk::WriteDescriptorSet> writes;
+  writes.reserve(buffers.size());
+  std::vector<vk::DescriptorBufferInfo> buffer_infos;
+  buffer_infos.reserve(buffers.size());
+
+  for (const auto& [binding, buffer]: buffers)
+  {
+    buffer_infos.push_back({.buffer = buffer->get(), .offset = 0, .range = vk::WholeSize});
+
+    writes.push_back({.dstSet = frame->DescriptorSet(),
+                      .dstBinding = binding,
+                      .dstArrayElement = 0,
+                      .descriptorCount = 1,
+                      .descriptorType = vk::DescriptorType::eStorageBuffer,
+                      .pBufferInfo = &buffer_infos.back()});
+  }
+
+  device_->get().updateDescriptorSets(writes.size(), writes.data(), 0, nullptr);
+
+  frame_descriptors_dirty_.at(frame_index) = false;
+}
+
+void VulkanRenderer::WriteStaticDescriptors(const uint32_t frame_index)
+{
+  const auto descriptor_set = static_descriptor_sets_.at(frame_index);
+
+  std::vector<vk::WriteDescriptorSet> writes;
+  writes.reserve(5);
+  std::vector<vk::DescriptorBufferInfo> buffer_infos;
+  buffer_infos.reserve(5);
+
+  buffer_infos.push_back({.buffer = geometry_heap_->MeshInfoBuffer()->get(), .offset = 0, .range = vk::WholeSize});
+
+  writes.push_back({.dstSet = descriptor_set,
+                    .dstBinding = 0,
+                    .dstArrayElement = 0,
+                    .descriptorCount = 1,
+                    .descriptorType = vk::DescriptorType::eStorageBuffer,
+                    .pBufferInfo = &buffer_infos.back()});
+
+  buffer_infos.push_back({.buffer = geometry_heap_->PositionBuffer()->get(), .offset = 0, .range = vk::WholeSize});
+
+  writes.push_back({.dstSet = descriptor_set,
+                    .dstBinding = 2,
+                    .dstArrayElement = 0,
+                    .descriptorCount = 1,
+                    .descriptorType = vk::DescriptorType::eStorageBuffer,
+                    .pBufferInfo = &buffer_infos.back()});
+
+  buffer_infos.push_back({.buffer = geometry_heap_->IndexBuffer()->get(), .offset = 0, .range = vk::WholeSize});
+
+  writes.push_back({.dstSet = descriptor_set,
+                    .dstBinding = 3,
+                    .dstArrayElement = 0,
+                    .descriptorCount = 1,
+                    .descriptorType = vk::DescriptorType::eStorageBuffer,
+                    .pBufferInfo = &buffer_infos.back()});
+
+  buffer_infos.push_back({.buffer = geometry_heap_->MeshletBuffer()->get(), .offset = 0, .range = vk::WholeSize});
+
+  writes.push_back({.dstSet = descriptor_set,
+                    .dstBinding = 4,
+                    .dstArrayElement = 0,
+                    .descriptorCount = 1,
+                    .descriptorType = vk::DescriptorType::eStorageBuffer,
+                    .pBufferInfo = &buffer_infos.back()});
+
+  buffer_infos.push_back({.buffer = geometry_heap_->AttributeBuffer()->get(), .offset = 0, .range = vk::WholeSize});
+
+  writes.push_back({.dstSet = descriptor_set,
+                    .dstBinding = 5,
+                    .dstArrayElement = 0,
+                    .descriptorCount = 1,
+                    .descriptorType = vk::DescriptorType::eStorageBuffer,
+                    .pBufferInfo = &buffer_infos.back()});
+
+  device_->get().updateDescriptorSets(writes.size(), writes.data(), 0, nullptr);
+
+  static_descriptors_dirty_.at(frame_index) = false;
+}
+
+void VulkanRenderer::WriteTextureDescriptors(const uint32_t frame_index)
+{
+  auto& pending = pending_texture_descriptors_.at(frame_index);
+  if (pending.empty())
+  {
+    return;
+  }
+
+  ZoneScopedN("VulkanRenderer::WriteTextureDescriptors");
+
+  std::ranges::sort(pending);
+  const auto [first, last] = std::ranges::unique(pending);
+  pending.erase(first, last);
+
+  // one write per texture, the rest of the table stays as it is
+  std::vector<vk::WriteDescriptorSet> writes;
+  writes.reserve(pending.size());
+  std::vector<vk::DescriptorImageInfo> image_infos;
+  image_infos.reserve(pending.size());
+
+  for (const auto texture: pending)
+  {
+    // removed since, nothing samples it anymore
+    if (!texture_streamer_->HasImage(texture))
+    {
+      continue;
+    }
+
+    image_infos.push_back({.sampler = texture_sampler_.get(),
+                           .imageView = texture_streamer_->View(texture),
+                           .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal});
+
+    writes.push_back({.dstSet = static_descriptor_sets_.at(frame_index),
+                      .dstBinding = 1,
+                      .dstArrayElement = texture,
+                      .descriptorCount = 1,
+                      .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+                      .pImageInfo = &image_infos.back()});
+  }
+
+  device_->get().updateDescriptorSets(writes.size(), writes.data(), 0, nullptr);
+
+  pending.clear();
+}
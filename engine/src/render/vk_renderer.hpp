@@ -1,7 +1,11 @@
 #pragma once
+#include <array>
+#include <cstddef>
 #include <glm/glm.hpp>
 #include <memory>
 #include <optional>
+#include <span>
+#include <vector>
 #include <vulkan/vulkan.hpp>
 
 #include "util/frustum.hpp"
@@ -24,26 +28,87 @@ class VulkanAllocator;
 class Window;
 class ResourceManager;
 class EventManager;
+class JobSystem;
 class VulkanInstance;
 class VulkanSurface;
 class VulkanDevice;
+class VulkanGeometryHeap;
+class VulkanTextureStreamer;
+class VulkanShaderReloader;
+class VulkanUploadQueue;
+
+// How a mesh's vertices are stored in the geometry buffers. Meshes are quantized unless they opt out, full keeps floats
+// for assets that need the precision.
+enum class VertexFormat : uint32_t
+{
+  kFull = 0,
+  kQuantized = 1,
+};
 
 struct MeshInfo
 {
   glm::vec3 b_min;
-  float padding1{};
+  VertexFormat vertex_format;
   glm::vec3 b_max;
   uint32_t index_count;
   uint32_t first_index;
-  int32_t vertex_offset;
-  std::array<int32_t, 2> padding2{};
+  int32_t vertex_offset; // into the position stream, in kVertexUnitSize units
+  uint32_t meshlet_offset;
+  uint32_t meshlet_count;
+  uint32_t lod_count; // lods are the mesh infos right after this one
+  float lod_error;
+  uint32_t attribute_offset; // into the attribute stream, in kVertexUnitSize units
+  uint32_t padding2{};
+};
+
+// One level of detail of a mesh. All lods share the mesh's vertices, the ranges are relative to the mesh's own indices
+// and meshlets.
+struct MeshLod
+{
+  uint32_t first_index;
+  uint32_t index_count;
+  uint32_t meshlet_offset{};
+  uint32_t meshlet_count{};
+  float error{}; // object space distance the simplified surface can be off from the full mesh
+};
+
+// Small cluster of a mesh's triangles, culled on its own in the second culling stage.
+struct Meshlet
+{
+  glm::vec3 center;
+  float radius;
+  glm::vec3 cone_apex;
+  float padding1{};
+  glm::vec3 cone_axis;
+  float cone_cutoff; // backfacing from everywhere with dot(normalize(apex - eye), axis) >= cutoff
+  uint32_t first_index; // relative to the mesh's first index
+  uint32_t index_count;
+  std::array<uint32_t, 2> padding2{};
+};
+
+// One per indirect draw, the draw's firstInstance points at it.
+struct DrawItem
+{
+  uint32_t object_index;
+  uint32_t first_index;
+};
+
+// How a texture's texels are stored. The block compressed formats store 4x4 texel blocks, bc1 for opaque textures and
+// bc3 for textures with alpha. All of them are srgb.
+enum class TextureFormat : uint32_t
+{
+  kRgba8 = 0,
+  kBc1 = 1,
+  kBc3 = 2,
 };
 
-struct TextureInfo
+// One level of a texture's mip chain, the offset is into the texture's data.
+struct TextureMip
 {
-  uint32_t texture_id;
-  int32_t width;
-  int32_t height;
+  uint32_t width;
+  uint32_t height;
+  uint64_t offset;
+  uint64_t size;
 };
 
 struct PushConstant
@@ -52,10 +117,35 @@ struct PushConstant
   glm::mat4 proj;
 };
 
-struct ComputePushConstant
+// Per frame culling inputs, too big for push constants so it lives in a mapped buffer.
+struct CullData
 {
+  glm::mat4 view;
+  glm::mat4 proj;
   Frustum frustum;
+  glm::vec3 camera_position;
   uint32_t render_object_count;
+  uint32_t max_object_count; // per phase
+  uint32_t max_draw_count; // per phase
+  float lod_scale; // object space error / distance * lod_scale = error in pixels
+  float lod_threshold; // in pixels
+  glm::vec2 depth_pyramid_size;
+  float near_plane;
+  uint32_t occlusion_culling;
+  uint32_t mesh_info_count;
+  uint32_t max_mesh_info_count; // per phase
+  uint32_t instanced_draws; // one instanced draw per mesh lod instead of one draw per meshlet
+  uint32_t object_update_count;
+};
+
+struct CullPushConstant
+{
+  uint32_t phase; // 0 draws what was visible last frame, 1 tests everything else against the depth pyramid
+};
+
+struct DepthPyramidPushConstant
+{
+  glm::vec2 image_size;
 };
 
 struct Vertex
@@ -70,6 +160,77 @@ struct Vertex
   std::array<float, 2> padding4{};
 };
 
+// Vertices are split into two streams. Positions are all the pre-pass reads, the rest is only read when shading.
+struct VertexAttributes
+{
+  glm::vec3 color;
+  glm::vec3 normal;
+  glm::vec2 tex_coord;
+};
+
+// Quantized to the mesh bounds.
+struct QuantizedPosition
+{
+  std::array<uint16_t, 3> position;
+  uint16_t padding{};
+};
+
+// Octahedral normal with 8 bits per axis, uv as two halfs and rgba8 color.
+struct QuantizedAttributes
+{
+  uint16_t normal;
+  uint16_t padding{};
+  uint32_t tex_coord;
+  uint32_t color;
+};
+
+// Both streams are allocated and addressed in units of this.
+inline constexpr uint32_t kVertexUnitSize = 4;
+
+constexpr uint32_t PositionStride(const VertexFormat format)
+{
+  return format == VertexFormat::kFull ? sizeof(glm::vec3) : sizeof(QuantizedPosition);
+}
+
+constexpr uint32_t AttributeStride(const VertexFormat format)
+{
+  return format == VertexFormat::kFull ? sizeof(VertexAttributes) : sizeof(QuantizedAttributes);
+}
+
+static_assert(PositionStride(VertexFormat::kFull) % kVertexUnitSize == 0);
+static_assert(PositionStride(VertexFormat::kQuantized) % kVertexUnitSize == 0);
+static_assert(AttributeStride(VertexFormat::kFull) % kVertexUnitSize == 0);
+static_assert(AttributeStride(VertexFormat::kQuantized) % kVertexUnitSize == 0);
+
+// Width and height of a block in texels, rgba8 counts every texel as its own block.
+constexpr uint32_t TextureBlockSize(const TextureFormat format)
+{
+  return format == TextureFormat::kRgba8 ? 1 : 4;
+}
+
+constexpr uint32_t TextureBlockBytes(const TextureFormat format)
+{
+  switch (format)
+  {
+    case TextureFormat::kBc1:
+      return 8;
+    case TextureFormat::kBc3:
+      return 16;
+    default:
+      return 4;
+  }
+}
+
+constexpr uint64_t TextureMipBytes(const TextureFormat format, const uint32_t width, const uint32_t height)
+{
+  const uint32_t block = TextureBlockSize(format);
+  return static_cast<uint64_t>((width + block - 1) / block) * ((height + block - 1) / block) *
+         TextureBlockBytes(format);
+}
+
+// Mesh id of a free object table slot, culling skips it.
+inline constexpr uint32_t kInvalidMeshId = UINT32_MAX;
+
 struct RenderObject
 {
   glm::mat4 model;
@@ -78,6 +239,14 @@ struct RenderObject
   std::array<int32_t, 2> pad;
 };
 
+// One changed slot of the object table, scattered into it at the start of the frame.
+struct ObjectUpdate
+{
+  uint32_t slot;
+  std::array<uint32_t, 3> padding{};
+  RenderObject object;
+};
+
 struct DebugLineVertex
 {
   glm::vec3 position;
@@ -89,7 +258,8 @@ struct DebugLineVertex
 class VulkanRenderer
 {
 public:
-  explicit VulkanRenderer(Window *window, ResourceManager &resource_manager, EventManager &event_manager);
+  explicit VulkanRenderer(Window *window, ResourceManager &resource_manager, EventManager &event_manager,
+                          JobSystem &jobs);
   VulkanRenderer(const VulkanRenderer &) = delete;
   VulkanRenderer(VulkanRenderer &&) = delete;
   VulkanRenderer &operator=(const VulkanRenderer &) = delete;
@@ -98,15 +268,43 @@ public:
 
   void run(glm::mat4 world, float fov);
 
-  uint32_t AddMesh(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, uint32_t first_index,
-                   int32_t vertex_offset, const glm::vec3 &b_min, const glm::vec3 &b_max);
+  // positions and attributes are the two vertex streams in vertex_format, quantized positions are relative to b_min
+  // and b_max.
+  uint32_t AddMesh(std::span<const std::byte> positions, std::span<const std::byte> attributes,
+                   VertexFormat vertex_format, std::span<const uint32_t> indices, std::span<const Meshlet> meshlets,
+                   std::span<const MeshLod> lods, const glm::vec3 &b_min, const glm::vec3 &b_max);
+  // Objects must not use the mesh anymore. Its geometry is freed once the frames in flight are done with it.
+  void RemoveMesh(uint32_t mesh_id);
+
+  // data holds every mip in format, the mips point into it. Only the mip tail goes to the gpu at first, the finer
+  // levels are streamed in once the shading pass asks for them. If owner is set it keeps data alive and data is read
+  // in place, otherwise it's copied.
+  uint32_t AddTexture(TextureFormat format, std::span<const TextureMip> mips, std::span<const std::byte> data,
+                      std::shared_ptr<const void> owner = {});
+  // Frees the texture's slot in the bindless table for the next AddTexture, objects must not use it anymore.
+  void RemoveTexture(uint32_t texture);
+  // Without it AddTexture decodes bc textures to rgba8. Safe to call from any thread.
+  [[nodiscard]] bool SupportsBlockCompression() const;
+
+  // Uploads textures added since the last call. Meshes are uploaded by AddMesh directly.
+  void Upload();
 
-  uint32_t AddTexture(std::span<const unsigned char> texture, int32_t width, int32_t height);
+  // Bytes of texture mips kept on the gpu, the mip tails stay resident even if they don't fit.
+  void SetTextureBudget(uint64_t bytes);
 
-  void Upload();
+  // Objects live in a persistent table on the gpu and keep their slot until they're destroyed. Only slots that changed
+  // since the last frame are uploaded.
+  uint32_t CreateObject(const glm::mat4 &model, uint32_t mesh_id, int32_t texture_id = -1);
+  void UpdateObject(uint32_t slot, const glm::mat4 &model, uint32_t mesh_id, int32_t texture_id = -1);
+  void DestroyObject(uint32_t slot);
 
-  void RenderMesh(const glm::mat4 &model, uint32_t mesh_id, int32_t texture_id = -1);
-  void ClearMeshes(uint32_t reserve = 0);
+  // Bulk path for many objects at once. CreateObjects hands out slots without writing them, WriteObject fills one and
+  // is safe to call from several threads as long as they write distinct slots and nothing else touches the objects in
+  // the meantime. CommitObjects queues the written slots for upload. Every created slot has to be written and
+  // committed.
+  void CreateObjects(std::span<uint32_t> slots);
+  void WriteObject(uint32_t slot, const glm::mat4 &model, uint32_t mesh_id, int32_t texture_id = -1);
+  void CommitObjects(std::span<const uint32_t> slots);
 
   void RenderLine(const glm::vec3 &point_a, const glm::vec3 &point_b, const glm::vec3 &color);
   void ClearLines();
@@ -122,6 +320,26 @@ private:
   void RecreateSwapChain();
   void RecreateFrameImages(uint32_t width, uint32_t height) const;
 
+  void ResizeObjectTable(uint32_t capacity);
+  // Carries the old object table over into the one ResizeObjectTable made, before anything uses it this frame.
+  void RecordObjectTableResize(vk::CommandBuffer cmd);
+  void GrowBuffers(VulkanFrame &frame);
+
+  [[nodiscard]] uint32_t AllocateObjectSlot();
+  void MarkObjectDirty(uint32_t slot);
+  [[nodiscard]] uint32_t WriteObjectUpdates(const VulkanFrame &frame);
+  void RecordObjectUpdates(vk::CommandBuffer cmd, const VulkanFrame &frame, uint32_t update_count) const;
+  void RecordCulling(vk::CommandBuffer cmd, const VulkanFrame &frame, uint32_t phase, bool instanced) const;
+  void RecordPrePass(vk::CommandBuffer cmd, const VulkanFrame &frame, uint32_t phase,
+                     const PushConstant &push_constant) const;
+  void RecordDepthPyramid(vk::CommandBuffer cmd, const VulkanFrame &frame) const;
+
+  void MarkStaticDescriptorsDirty();
+  void WriteStaticDescriptors(uint32_t frame_index);
+  void WriteTextureDescriptors(uint32_t frame_index);
+  void MarkFrameDescriptorsDirty();
+  void WriteFrameDescriptors(uint32_t frame_index);
+
   static constexpr uint32_t max_frames_in_flight_ = 2;
 
   std::unique_ptr<VulkanInstance> instance_;
@@ -133,10 +351,17 @@ private:
 
   std::unique_ptr<VulkanCommandPool> graphics_pool_;
   std::unique_ptr<VulkanCommandPool> transfer_pool_;
+  // mesh and texture copies, the frames wait on it when they need the data
+  std::unique_ptr<VulkanUploadQueue> uploads_;
 
   std::unique_ptr<VulkanShader> pre_pass_vert_;
   std::unique_ptr<VulkanShader> pre_pass_frag_;
+  std::unique_ptr<VulkanShader> object_scatter_comp_;
   std::unique_ptr<VulkanShader> culling_comp_;
+  std::unique_ptr<VulkanShader> cluster_culling_comp_;
+  std::unique_ptr<VulkanShader> depth_pyramid_comp_;
+  std::unique_ptr<VulkanShader> instance_offsets_comp_;
+  std::unique_ptr<VulkanShader> instance_compaction_comp_;
   std::unique_ptr<VulkanShader> shading_comp_;
 
   std::unique_ptr<VulkanShader> debug_line_vert_;
@@ -146,7 +371,21 @@ private:
 
   std::unique_ptr<VulkanDescriptorSetLayout> static_descriptor_set_layout_;
   std::unique_ptr<VulkanDescriptorSetLayout> frame_descriptor_set_layout_;
-  vk::DescriptorSet static_descriptor_set_;
+  std::unique_ptr<VulkanDescriptorSetLayout> depth_pyramid_descriptor_set_layout_;
+
+  // One copy per frame in flight so a set can be rewritten while the other frames still use theirs.
+  std::array<vk::DescriptorSet, max_frames_in_flight_> static_descriptor_sets_;
+  std::array<bool, max_frames_in_flight_> static_descriptors_dirty_{};
+  // the frame sets' buffer bindings, rewritten when a buffer they point at is replaced
+  std::array<bool, max_frames_in_flight_> frame_descriptors_dirty_{};
+  uint64_t geometry_generation_ = 0;
+  // Bindless texture table, binding 1 of the static sets. Only the entries of textures whose image changed get
+  // written, each frame's set catches up at the start of that frame so a frame in flight never sees a change.
+  uint32_t texture_capacity_ = 0;
+  std::array<std::vector<uint32_t>, max_frames_in_flight_> pending_texture_descriptors_;
+
+  // One set per pyramid level per frame, level n reads level n - 1 (or the depth image) and writes level n
+  std::array<std::vector<vk::DescriptorSet>, max_frames_in_flight_> depth_pyramid_descriptor_sets_;
 
   std::unique_ptr<VulkanPipelineLayout> pre_pass_pipeline_layout_;
   std::unique_ptr<VulkanPipeline> pre_pass_pipeline_;
@@ -154,34 +393,70 @@ private:
   std::unique_ptr<VulkanPipeline> debug_line_pipeline_;
   std::unique_ptr<VulkanPipelineLayout> culling_pipeline_layout_;
   std::unique_ptr<VulkanPipeline> culling_pipeline_;
+  std::unique_ptr<VulkanPipeline> object_scatter_pipeline_;
+  std::unique_ptr<VulkanPipeline> cluster_culling_pipeline_;
+  std::unique_ptr<VulkanPipeline> instance_offsets_pipeline_;
+  std::unique_ptr<VulkanPipeline> instance_compaction_pipeline_;
+  std::unique_ptr<VulkanPipelineLayout> depth_pyramid_pipeline_layout_;
+  std::unique_ptr<VulkanPipeline> depth_pyramid_pipeline_;
   std::unique_ptr<VulkanPipelineLayout> shading_pipeline_layout_;
   std::unique_ptr<VulkanPipeline> shading_pipeline_;
 
+  // rebuilds the pipelines above when their shaders change
+  std::unique_ptr<VulkanShaderReloader> shader_reloader_;
+
   // https://docs.vulkan.org/guide/latest/swapchain_semaphore_reuse.html
   std::vector<std::unique_ptr<VulkanFrame>> frames_;
   std::vector<vk::UniqueSemaphore> submit_semaphores_;
 
   uint32_t current_frame_ = 0;
   float aspect_ratio_ = 1.0F;
+  float lod_threshold_ = 1.0F;
+  bool occlusion_culling_ = true;
+  bool instanced_draws_ = false;
 
+  // Cpu copy of the object table, indexed by slot. Dirty slots go out with the next frame's updates.
   std::vector<RenderObject> render_objects_;
+  std::vector<uint32_t> free_object_slots_;
+  std::vector<uint32_t> dirty_object_slots_;
+  std::vector<bool> object_dirty_;
 
   std::vector<DebugLineVertex> debug_line_vertices_;
 
-  std::vector<Vertex> vertices_;
-  std::vector<uint32_t> indices_;
-  std::vector<MeshInfo> mesh_infos_;
-  std::unique_ptr<VulkanBuffer> vertex_buffer_;
-  std::unique_ptr<VulkanBuffer> index_buffer_;
-  std::unique_ptr<VulkanBuffer> mesh_info_buffer_;
+  std::unique_ptr<VulkanGeometryHeap> geometry_heap_;
   vk::UniqueSampler visibility_sampler_;
-
-  std::vector<std::vector<unsigned char>> textures_;
-  std::vector<TextureInfo> texture_infos_;
-  std::vector<std::unique_ptr<VulkanImage>> texture_images_;
+  vk::UniqueSampler depth_pyramid_sampler_;
+
+  struct RetiredBuffer
+  {
+    std::unique_ptr<VulkanBuffer> buffer;
+    uint32_t frames_left{};
+  };
+
+  // What a resize copies from, null buffers the first time. Recorded by the next frame.
+  struct ObjectTableCopy
+  {
+    VulkanBuffer *table = nullptr;
+    VulkanBuffer *visibility = nullptr;
+    uint32_t capacity = 0;
+  };
+
+  // The object table itself, shared by all frames like the visibility flags below. Both hold object_capacity_ entries.
+  std::unique_ptr<VulkanBuffer> object_table_;
+  std::optional<ObjectTableCopy> object_table_copy_;
+  std::vector<RetiredBuffer> retired_buffers_; // old object tables the frames in flight may still use
+  uint32_t object_capacity_ = 0;
+  uint32_t buffer_growth_count_ = 0;
+
+  // One visibility flag per render object, written by the second culling phase and read by the next frame's first.
+  // Shared by all frames, frames run in order on the graphics queue.
+  std::unique_ptr<VulkanBuffer> object_visibility_buffer_;
+
+  std::unique_ptr<VulkanTextureStreamer> texture_streamer_;
   vk::UniqueSampler texture_sampler_;
 
 
   Window *window_ = nullptr;
   EventManager *event_manager_ = nullptr;
+  JobSystem *jobs_ = nullptr;
 };
@@ -0,0 +1,224 @@
+#include "render/vk_shader_reloader.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <variant>
+
+#include "render/vk_shader.hpp"
+#include "resource/types/shader_resource.hpp"
+#include "tracy/Tracy.hpp"
+#include "util/print.hpp"
+
+#ifndef ENGINE_SLANGC
+#define ENGINE_SLANGC "slangc"
+#endif
+
+namespace
+{
+  // the stages of info, in the order Track got the shader names
+  std::vector<vk::PipelineShaderStageCreateInfo*> Stages(PipelineInfo& info)
+  {
+    if (auto* graphics = std::get_if<GraphicsPipelineInfo>(&info))
+    {
+      std::vector<vk::PipelineShaderStageCreateInfo*> stages;
+      for (auto& stage: graphics->shader_stages)
+      {
+        stages.push_back(&stage);
+      }
+      return stages;
+    }
+    return {&std::get<ComputePipelineInfo>(info).shader_stage};
+  }
+} // namespace
+
+VulkanShaderReloader::VulkanShaderReloader(const vk::Device device, JobSystem& jobs, std::filesystem::path shader_dir,
+                                           const uint32_t frames_in_flight) :
+    shader_dir_(std::move(shader_dir)), frames_in_flight_(frames_in_flight), device_(device), jobs_(&jobs),
+    watcher_({shader_dir_})
+{
+}
+
+// The engine destroys the job system first and that runs a queued rebuild to the end, nothing to wait for here.
+VulkanShaderReloader::~VulkanShaderReloader() = default;
+
+void VulkanShaderReloader::Track(std::unique_ptr<VulkanPipeline>* pipeline, const PipelineInfo& info,
+                                 std::vector<std::string> shaders)
+{
+  tracked_.push_back({.pipeline = pipeline, .info = info, .shaders = std::move(shaders)});
+}
+
+void VulkanShaderReloader::Update()
+{
+  for (auto& retired: retired_)
+  {
+    --retired.frames_left;
+  }
+  std::erase_if(retired_, [](const RetiredPipeline& retired) { return retired.frames_left == 0; });
+
+  if (rebuild_ && rebuild_->job->Done())
+  {
+    Finish();
+  }
+
+  // changes that come in during a rebuild wait for the next one
+  if (!rebuild_)
+  {
+    if (const auto changed = watcher_.TakeChanged(); !changed.empty())
+    {
+      Start(changed);
+    }
+  }
+}
+
+void VulkanShaderReloader::Start(const std::vector<std::filesystem::path>& changed)
+{
+  std::vector<std::string> known;
+  for (const auto& tracked: tracked_)
+  {
+    known.insert(known.end(), tracked.shaders.begin(), tracked.shaders.end());
+  }
+  std::ranges::sort(known);
+  known.erase(std::ranges::unique(known).begin(), known.end());
+
+  auto rebuild = std::make_unique<Rebuild>();
+  const auto add = [&](const std::string& shader)
+  {
+    if (std::ranges::find(rebuild->shaders, shader) == rebuild->shaders.end())
+    {
+      rebuild->shaders.push_back(shader);
+    }
+  };
+
+  for (const auto& path: changed)
+  {
+    if (path.extension() == ".spv")
+    {
+      continue;
+    }
+
+    if (path.extension() == ".slang")
+    {
+      if (const auto shader = path.stem().string(); std::ranges::binary_search(known, shader))
+      {
+        add(shader);
+      }
+      continue;
+    }
+
+    // an include, good enough to look for its name in the sources
+    const auto name = path.filename().string();
+    for (const auto& shader: known)
+    {
+      std::ifstream file(shader_dir_ / (shader + ".slang"));
+      const std::string source{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+      if (source.find(name) != std::string::npos)
+      {
+        add(shader);
+      }
+    }
+  }
+
+  if (rebuild->shaders.empty())
+  {
+    return;
+  }
+
+  for (size_t i{}; i < tracked_.size(); i++)
+  {
+    if (std::ranges::any_of(tracked_[i].shaders, [&](const std::string& shader)
+                            { return std::ranges::find(rebuild->shaders, shader) != rebuild->shaders.end(); }))
+    {
+      rebuild->pipelines.emplace_back(i, tracked_[i]);
+    }
+  }
+
+  util::println("Reloading {} shader(s), {} pipeline(s)", rebuild->shaders.size(), rebuild->pipelines.size());
+
+  auto* target = rebuild.get();
+  rebuild->job = jobs_->Submit([this, target] { Build(*target); });
+  rebuild_ = std::move(rebuild);
+}
+
+void VulkanShaderReloader::Finish()
+{
+  auto rebuild = std::move(rebuild_);
+
+  // all or nothing, a half swapped set of pipelines could disagree on what's in the buffers they share
+  if (rebuild->built.size() != rebuild->pipelines.size() ||
+      std::ranges::any_of(rebuild->built, [](const auto& pipeline) { return pipeline == nullptr; }))
+  {
+    util::println("Shader reload failed, keeping the old pipelines");
+    return;
+  }
+
+  for (size_t i{}; i < rebuild->pipelines.size(); i++)
+  {
+    auto& [index, tracked] = rebuild->pipelines[i];
+    auto& pipeline = *tracked.pipeline;
+    // frames in flight still use the old one
+    retired_.push_back({.pipeline = std::move(pipeline), .frames_left = frames_in_flight_});
+    pipeline = std::move(rebuild->built[i]);
+    tracked_[index].info = std::move(tracked.info);
+  }
+
+  // every pipeline that used the old modules was just rebuilt, nothing references them anymore
+  for (auto& [shader, module]: rebuild->modules)
+  {
+    modules_[shader] = std::move(module);
+  }
+
+  util::println("Reloaded {} pipeline(s)", rebuild->pipelines.size());
+}
+
+void VulkanShaderReloader::Build(Rebuild& rebuild) const
+{
+  ZoneScopedN("VulkanShaderReloader::Build");
+
+  try
+  {
+    for (const auto& shader: rebuild.shaders)
+    {
+      if (!Compile(shader))
+      {
+        return;
+      }
+      const auto code = ShaderResourceLoader{}((shader_dir_ / (shader + ".spv")).string());
+      rebuild.modules.emplace(shader, std::make_unique<VulkanShader>(device_, code.code));
+    }
+
+    for (auto& [index, tracked]: rebuild.pipelines)
+    {
+      const auto stages = Stages(tracked.info);
+      for (size_t stage{}; stage < stages.size() && stage < tracked.shaders.size(); stage++)
+      {
+        if (const auto it = rebuild.modules.find(tracked.shaders[stage]); it != rebuild.modules.end())
+        {
+          stages[stage]->module = it->second->get();
+        }
+      }
+      rebuild.built.push_back(std::make_unique<VulkanPipeline>(device_, tracked.info));
+    }
+  } catch (const std::exception& e)
+  {
+    util::println("Shader reload failed: {}", e.what());
+  }
+}
+
+bool VulkanShaderReloader::Compile(const std::string& shader) const
+{
+  const auto source = shader_dir_ / (shader + ".slang");
+  const auto output = shader_dir_ / (shader + ".spv");
+  // same as compile_shaders
+  const auto command =
+      std::format(R"("{}" -target spirv -o "{}" "{}")", ENGINE_SLANGC, output.string(), source.string());
+  if (std::system(command.c_str()) != 0)
+  {
+    util::println("Failed to compile {}", source.string());
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+#include "core/file_watcher.hpp"
+#include "core/job_system.hpp"
+#include "render/vk_pipeline.hpp"
+
+class VulkanShader;
+
+// Recompiles shaders when their sources change and rebuilds the pipelines that use them. Shaders are named after their
+// source without the extension, "shading.comp" is built from shading.comp.slang into shading.comp.spv next to it, the
+// way compile_shaders does it. A change to anything else in the directory, like an include, rebuilds every shader that
+// mentions the file. Compiling and building runs as a job, the finished pipelines replace the old ones in Update. A
+// shader that fails to compile keeps the pipelines it had.
+class VulkanShaderReloader
+{
+public:
+  VulkanShaderReloader(vk::Device device, JobSystem& jobs, std::filesystem::path shader_dir,
+                       uint32_t frames_in_flight);
+  VulkanShaderReloader(const VulkanShaderReloader&) = delete;
+  VulkanShaderReloader(VulkanShaderReloader&&) = delete;
+  VulkanShaderReloader& operator=(const VulkanShaderReloader&) = delete;
+  VulkanShaderReloader& operator=(VulkanShaderReloader&&) = delete;
+  ~VulkanShaderReloader();
+
+  // pipeline was built from info, stage i of info uses shaders[i]. It gets replaced whenever one of them changes.
+  void Track(std::unique_ptr<VulkanPipeline>* pipeline, const PipelineInfo& info, std::vector<std::string> shaders);
+
+  // Call once per frame after the frame fence was waited on, before anything is recorded. Swaps in the pipelines of a
+  // finished rebuild and starts the next one if sources changed since.
+  void Update();
+
+private:
+  struct Tracked
+  {
+    std::unique_ptr<VulkanPipeline>* pipeline;
+    PipelineInfo info; // with the modules of the last successful build
+    std::vector<std::string> shaders;
+  };
+
+  // What a rebuild job hands back, written by the job and read once it's done.
+  struct Rebuild
+  {
+    std::vector<std::string> shaders;
+    std::unordered_map<std::string, std::unique_ptr<VulkanShader>> modules;
+    std::vector<std::pair<size_t, Tracked>> pipelines; // index into tracked_, with the new info
+    std::vector<std::unique_ptr<VulkanPipeline>> built; // same order as pipelines
+    JobHandle job;
+  };
+
+  struct RetiredPipeline
+  {
+    std::unique_ptr<VulkanPipeline> pipeline;
+    uint32_t frames_left{};
+  };
+
+  void Start(const std::vector<std::filesystem::path>& changed);
+  void Finish();
+  // runs on a worker, must not throw
+  void Build(Rebuild& rebuild) const;
+  [[nodiscard]] bool Compile(const std::string& shader) const;
+
+  std::vector<Tracked> tracked_;
+  std::unordered_map<std::string, std::unique_ptr<VulkanShader>> modules_; // the ones built by reloads
+  std::unique_ptr<Rebuild> rebuild_;
+  std::vector<RetiredPipeline> retired_;
+
+  std::filesystem::path shader_dir_;
+  uint32_t frames_in_flight_;
+
+  vk::Device device_;
+  JobSystem* jobs_;
+  FileWatcher watcher_;
+};
@@ -0,0 +1,407 @@
+#include "render/vk_texture_streamer.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <functional>
+#include <numeric>
+#include <stdexcept>
+
+#include "render/vk_device.hpp"
+#include "render/vk_image.hpp"
+#include "render/vk_upload_queue.hpp"
+#include "resource/types/texture_resource.hpp"
+#include "tracy/Tracy.hpp"
+#include "vk_allocator.hpp"
+
+// levels at or below this size are always resident, a texture is never unsampleable
+constexpr uint32_t kMaxTailSize = 64;
+// a texture that wasn't seen for this many updates falls back to its tail
+constexpr uint32_t kEvictAfterUpdates = 120;
+// spreads big jumps in what's needed over several frames, a single texture that needs more still gets through
+constexpr uint64_t kMaxStreamBytesPerUpdate = 16ULL << 20;
+
+namespace
+{
+  vk::Format ToVkFormat(const TextureFormat format)
+  {
+    switch (format)
+    {
+      case TextureFormat::kBc1:
+        return vk::Format::eBc1RgbSrgbBlock;
+      case TextureFormat::kBc3:
+        return vk::Format::eBc3SrgbBlock;
+      default:
+        return vk::Format::eR8G8B8A8Srgb;
+    }
+  }
+} // namespace
+
+VulkanTextureStreamer::VulkanTextureStreamer(VulkanDevice* device, VulkanAllocator* allocator,
+                                             VulkanUploadQueue* uploads, const uint32_t frames_in_flight,
+                                             const uint32_t capacity, const uint64_t budget) :
+    frames_in_flight_(frames_in_flight), capacity_(capacity), budget_(budget), device_(device), allocator_(allocator),
+    uploads_(uploads)
+{
+  queue_families_.push_back(device_->QueueFamilies().graphics.value());
+  if (device_->QueueFamilies().transfer.value() != queue_families_.front())
+  {
+    queue_families_.push_back(device_->QueueFamilies().transfer.value());
+  }
+}
+
+VulkanTextureStreamer::~VulkanTextureStreamer() = default;
+
+uint32_t VulkanTextureStreamer::Add(const TextureFormat format, const std::span<const TextureMip> mips,
+                                    const std::span<const std::byte> data, std::shared_ptr<const void> owner)
+{
+  if (mips.empty())
+  {
+    throw std::runtime_error("Texture has no mips");
+  }
+  if (format != TextureFormat::kRgba8 && !device_->SupportsBlockCompression())
+  {
+    // the loaders decode on their worker already, this only catches textures that got here some other way
+    auto rgba = std::make_shared<const TextureData>(
+        DecodeTextureData(TextureData{.format = format, .mips = mips, .data = data}));
+    return Add(TextureFormat::kRgba8, rgba->mips, rgba->data, rgba);
+  }
+  // every chain from some level down is one contiguous range, that's what gets staged
+  for (size_t level{}; level < mips.size(); level++)
+  {
+    const auto& mip = mips[level];
+    if (mip.offset + mip.size > data.size() || mip.size != TextureMipBytes(format, mip.width, mip.height) ||
+        (level > 0 && mip.offset != mips[level - 1].offset + mips[level - 1].size))
+    {
+      throw std::runtime_error("Texture mip out of bounds");
+    }
+  }
+
+  uint32_t id{};
+  if (!free_.empty())
+  {
+    id = free_.back();
+    free_.pop_back();
+  } else if (textures_.size() < capacity_)
+  {
+    id = static_cast<uint32_t>(textures_.size());
+    textures_.emplace_back();
+  } else
+  {
+    throw std::runtime_error("Texture table is full");
+  }
+
+  auto& texture = textures_[id];
+  texture = Texture{
+      .format = format, .mips = {mips.begin(), mips.end()}, .tail = static_cast<uint32_t>(mips.size() - 1)};
+  if (owner)
+  {
+    // a mapped cooked file only takes memory for the pages that get streamed
+    texture.data = data;
+    texture.owner = std::move(owner);
+  } else
+  {
+    texture.storage.assign(data.begin(), data.end());
+    texture.data = texture.storage;
+  }
+  for (uint32_t level{}; level < mips.size(); level++)
+  {
+    if (std::max(mips[level].width, mips[level].height) <= kMaxTailSize)
+    {
+      texture.tail = level;
+      break;
+    }
+  }
+  texture.resident = texture.tail;
+  texture.requested = texture.tail;
+  texture.last_seen = update_count_;
+
+  total_bytes_ += ChainBytes(texture, 0);
+  pending_.push_back(id);
+  return id;
+}
+
+void VulkanTextureStreamer::Remove(const uint32_t texture)
+{
+  auto& removed = textures_.at(texture);
+  if (removed.mips.empty())
+  {
+    throw std::runtime_error("Texture was already removed");
+  }
+
+  total_bytes_ -= ChainBytes(removed, 0);
+  if (removed.image)
+  {
+    resident_bytes_ -= ChainBytes(removed, removed.resident);
+    // frames in flight may still sample it
+    retired_.push_back({.image = std::move(removed.image), .frames_left = frames_in_flight_});
+  }
+  if (removed.loading)
+  {
+    retired_.push_back({.image = std::move(removed.loading), .frames_left = 0, .upload = removed.loading_upload});
+  }
+  // nothing samples a removed texture, its descriptor can keep pointing wherever until the id is reused
+  std::erase(pending_, texture);
+  std::erase(changed_, texture);
+  removed = {};
+  free_.push_back(texture);
+}
+
+void VulkanTextureStreamer::Upload()
+{
+  if (pending_.empty())
+  {
+    return;
+  }
+
+  ZoneScopedN("VulkanTextureStreamer::Upload");
+
+  for (const auto i: pending_)
+  {
+    MakeResident(i, textures_[i].tail);
+  }
+  // objects can use them next frame, there's nothing older to fall back to
+  uploads_->Require(uploads_->RecordingValue());
+
+  pending_.clear();
+}
+
+void VulkanTextureStreamer::Update(const std::span<const uint32_t> feedback)
+{
+  ZoneScopedN("VulkanTextureStreamer::Update");
+
+  FinishLoads();
+
+  ++update_count_;
+  const auto count = static_cast<uint32_t>(textures_.size());
+
+  // the feedback is relative to one uv unit, the texture's size turns it into a level
+  for (uint32_t i{}; i < count; i++)
+  {
+    auto& texture = textures_[i];
+    if (!texture.image)
+    {
+      continue;
+    }
+    if (i < feedback.size() && feedback[i] != UINT32_MAX)
+    {
+      const uint32_t size = std::max(texture.mips.front().width, texture.mips.front().height);
+      const int32_t level = static_cast<int32_t>(feedback[i]) - static_cast<int32_t>(kTextureFeedbackBias) +
+                            static_cast<int32_t>(std::bit_width(size) - 1);
+      texture.requested = static_cast<uint32_t>(std::clamp(level, 0, static_cast<int32_t>(texture.tail)));
+      texture.last_seen = update_count_;
+    } else if (update_count_ - texture.last_seen > kEvictAfterUpdates)
+    {
+      texture.requested = texture.tail;
+    }
+  }
+
+  std::vector<uint32_t> targets(count);
+  uint64_t resident_bytes = resident_bytes_;
+  const auto drop = [&](const uint32_t i, const uint32_t level)
+  {
+    resident_bytes -= ChainBytes(textures_[i], targets[i]) - ChainBytes(textures_[i], level);
+    targets[i] = level;
+  };
+
+  // textures nobody looked at in a while go back to their tail right away, the rest keep what they have until the
+  // space is needed, so moving the camera back and forth doesn't reload the same levels
+  for (uint32_t i{}; i < count; i++)
+  {
+    targets[i] = textures_[i].resident;
+    if (textures_[i].last_seen + kEvictAfterUpdates < update_count_ && targets[i] < textures_[i].tail)
+    {
+      drop(i, textures_[i].tail);
+    }
+  }
+
+  bool dropped_surplus = false;
+  const auto drop_surplus = [&]
+  {
+    if (dropped_surplus)
+    {
+      return;
+    }
+    dropped_surplus = true;
+    for (uint32_t i{}; i < count; i++)
+    {
+      if (targets[i] < textures_[i].requested)
+      {
+        drop(i, textures_[i].requested);
+      }
+    }
+  };
+
+  // a lowered budget, take levels from the textures that weren't seen the longest
+  if (resident_bytes > budget_)
+  {
+    drop_surplus();
+
+    std::vector<uint32_t> order(count);
+    std::iota(order.begin(), order.end(), 0U);
+    std::ranges::sort(order, {}, [this](const uint32_t i) { return textures_[i].last_seen; });
+    for (const auto i: order)
+    {
+      while (resident_bytes > budget_ && targets[i] < textures_[i].tail)
+      {
+        drop(i, targets[i] + 1);
+      }
+    }
+  }
+
+  // the textures missing the most levels first
+  std::vector<uint32_t> loads;
+  for (uint32_t i{}; i < count; i++)
+  {
+    if (textures_[i].image && !textures_[i].loading && textures_[i].requested < targets[i])
+    {
+      loads.push_back(i);
+    }
+  }
+  std::ranges::sort(loads, std::greater{}, [&](const uint32_t i) { return targets[i] - textures_[i].requested; });
+
+  uint64_t streamed_bytes{};
+  for (const auto i: loads)
+  {
+    const auto& texture = textures_[i];
+    const uint64_t extra = ChainBytes(texture, texture.requested) - ChainBytes(texture, targets[i]);
+    if (streamed_bytes > 0 && streamed_bytes + extra > kMaxStreamBytesPerUpdate)
+    {
+      break;
+    }
+    if (resident_bytes + extra > budget_)
+    {
+      drop_surplus();
+      if (resident_bytes + extra > budget_)
+      {
+        continue;
+      }
+    }
+
+    resident_bytes += extra;
+    streamed_bytes += extra;
+    targets[i] = texture.requested;
+  }
+
+  for (uint32_t i{}; i < count; i++)
+  {
+    if (textures_[i].image && !textures_[i].loading && targets[i] != textures_[i].resident)
+    {
+      MakeResident(i, targets[i]);
+    }
+  }
+}
+
+void VulkanTextureStreamer::CollectRetired()
+{
+  for (auto& retired: retired_)
+  {
+    retired.frames_left -= retired.frames_left > 0 ? 1 : 0;
+  }
+  std::erase_if(retired_, [this](const RetiredImage& retired)
+                { return retired.frames_left == 0 && uploads_->Done(retired.upload); });
+}
+
+bool VulkanTextureStreamer::HasImage(const uint32_t texture) const
+{
+  return texture < textures_.size() && textures_[texture].image != nullptr;
+}
+
+vk::ImageView VulkanTextureStreamer::View(const uint32_t texture) const { return textures_.at(texture).image->view(); }
+
+// static
+uint64_t VulkanTextureStreamer::ChainBytes(const Texture& texture, const uint32_t first)
+{
+  const auto& last = texture.mips.back();
+  return last.offset + last.size - texture.mips.at(first).offset;
+}
+
+void VulkanTextureStreamer::MakeResident(const uint32_t index, const uint32_t first)
+{
+  auto& texture = textures_.at(index);
+  const auto cmd = uploads_->Record();
+
+  const auto& first_mip = texture.mips.at(first);
+  const uint64_t size = ChainBytes(texture, first);
+  auto new_image = std::make_unique<VulkanImage>(
+      ImageInfo{.width = first_mip.width,
+                .height = first_mip.height,
+                .format = ToVkFormat(texture.format),
+                .usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst,
+                .aspect_flags = vk::ImageAspectFlagBits::eColor,
+                .mip_levels = static_cast<uint32_t>(texture.mips.size()) - first,
+                .queue_families = queue_families_},
+      allocator_->get());
+
+  const auto staged = uploads_->Stage(texture.data.subspan(first_mip.offset, size));
+
+  // one region per mip, block compressed extents are in texels and may end inside a block at the small mips
+  std::vector<vk::BufferImageCopy> regions;
+  regions.reserve(texture.mips.size() - first);
+  for (auto level = first; level < texture.mips.size(); level++)
+  {
+    const auto& mip = texture.mips.at(level);
+    regions.push_back({.bufferOffset = staged.offset + mip.offset - first_mip.offset,
+                       .imageSubresource = {.aspectMask = vk::ImageAspectFlagBits::eColor,
+                                            .mipLevel = level - first,
+                                            .baseArrayLayer = 0,
+                                            .layerCount = 1},
+                       .imageExtent = {.width = mip.width, .height = mip.height, .depth = 1}});
+  }
+
+  new_image->TransitionLayout(cmd, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
+  cmd.copyBufferToImage(staged.buffer, new_image->get(), vk::ImageLayout::eTransferDstOptimal,
+                        static_cast<uint32_t>(regions.size()), regions.data());
+
+  // the transfer queue can't name the shader stages, the frames wait for the batch and that makes the copy visible
+  const vk::ImageMemoryBarrier2 barrier{
+      .srcStageMask = vk::PipelineStageFlagBits2::eCopy,
+      .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+      .dstStageMask = vk::PipelineStageFlagBits2::eNone,
+      .dstAccessMask = vk::AccessFlagBits2::eNone,
+      .oldLayout = vk::ImageLayout::eTransferDstOptimal,
+      .newLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .image = new_image->get(),
+      .subresourceRange = {.aspectMask = vk::ImageAspectFlagBits::eColor,
+                           .baseMipLevel = 0,
+                           .levelCount = VK_REMAINING_MIP_LEVELS,
+                           .baseArrayLayer = 0,
+                           .layerCount = VK_REMAINING_ARRAY_LAYERS}};
+  cmd.pipelineBarrier2(vk::DependencyInfo{.imageMemoryBarrierCount = 1, .pImageMemoryBarriers = &barrier});
+
+  if (texture.image)
+  {
+    texture.loading = std::move(new_image);
+    texture.loading_level = first;
+    texture.loading_upload = uploads_->RecordingValue();
+    return;
+  }
+
+  texture.image = std::move(new_image);
+  texture.resident = first;
+  resident_bytes_ += size;
+  changed_.push_back(index);
+}
+
+void VulkanTextureStreamer::FinishLoads()
+{
+  for (uint32_t i{}; i < textures_.size(); i++)
+  {
+    auto& texture = textures_[i];
+    if (!texture.loading || !uploads_->Done(texture.loading_upload))
+    {
+      continue;
+    }
+
+    resident_bytes_ -= ChainBytes(texture, texture.resident);
+    // frames in flight still sample the old image
+    retired_.push_back({.image = std::move(texture.image), .frames_left = frames_in_flight_});
+    texture.image = std::move(texture.loading);
+    texture.resident = texture.loading_level;
+    resident_bytes_ += ChainBytes(texture, texture.resident);
+    changed_.push_back(i);
+    // done on the cpu doesn't make the copy visible to the frame, it still has to wait on the gpu
+    uploads_->Require(texture.loading_upload);
+  }
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+#include "render/vk_renderer.hpp"
+
+class VulkanImage;
+class VulkanAllocator;
+class VulkanDevice;
+class VulkanUploadQueue;
+
+// What the shading pass writes per texture: the finest log2(uv units per pixel) it saw, offset by this so it fits an
+// unsigned atomic. UINT32_MAX means the texture wasn't seen.
+inline constexpr uint32_t kTextureFeedbackBias = 32;
+
+// Owns the texture images and decides which mips of them are on the gpu. Every texture keeps its full mip chain on the
+// cpu, only its mip tail is resident at first. The shading pass reports the level each texture needs, Update loads
+// the missing levels and drops the ones nobody needs anymore while staying under the budget. Changing what's resident
+// replaces the texture's image, the old one is kept alive until the frames in flight are done. Texture ids are slots in
+// the bindless texture table, ids of removed textures get handed out again.
+// Everything is copied on the upload queue. New textures are needed by the next frame, it waits for their tails.
+// Streamed levels go into an image of their own that only replaces the old one once its copy is done, rendering
+// carries on with the old one in the meantime.
+class VulkanTextureStreamer
+{
+public:
+  VulkanTextureStreamer(VulkanDevice* device, VulkanAllocator* allocator, VulkanUploadQueue* uploads,
+                        uint32_t frames_in_flight, uint32_t capacity, uint64_t budget);
+  VulkanTextureStreamer(const VulkanTextureStreamer&) = delete;
+  VulkanTextureStreamer(VulkanTextureStreamer&&) = delete;
+  VulkanTextureStreamer& operator=(const VulkanTextureStreamer&) = delete;
+  VulkanTextureStreamer& operator=(VulkanTextureStreamer&&) = delete;
+  ~VulkanTextureStreamer();
+
+  // data holds every mip in format, the mips point into it. Nothing is uploaded until the next Upload. Mips are
+  // streamed from data for as long as the texture lives, it's copied unless owner keeps it alive. Block compressed
+  // data is decoded to rgba8 on devices that can't sample it, loaders should do that on their worker beforehand.
+  uint32_t Add(TextureFormat format, std::span<const TextureMip> mips, std::span<const std::byte> data,
+               std::shared_ptr<const void> owner = {});
+  // The image stays alive until the frames in flight are done, the id can be reused by the next Add.
+  void Remove(uint32_t texture);
+
+  // Records the uploads of the mip tails of the textures added since the last call.
+  void Upload();
+
+  // feedback is what the shading pass wrote, one value per texture, it may be shorter than Count() for textures that
+  // were added after it was recorded.
+  void Update(std::span<const uint32_t> feedback);
+
+  // Call once per frame after the frame fence was waited on.
+  void CollectRetired();
+
+  // Highest id in use plus one.
+  [[nodiscard]] uint32_t Count() const { return static_cast<uint32_t>(textures_.size()); }
+  [[nodiscard]] uint32_t LiveCount() const { return Count() - static_cast<uint32_t>(free_.size()); }
+  [[nodiscard]] uint32_t Capacity() const { return capacity_; }
+  // False for removed textures and the ones waiting for Upload.
+  [[nodiscard]] bool HasImage(uint32_t texture) const;
+  [[nodiscard]] vk::ImageView View(uint32_t texture) const;
+
+  // The textures whose image got replaced since the last call, their descriptors need to be rewritten.
+  [[nodiscard]] std::vector<uint32_t> TakeChanged() { return std::exchange(changed_, {}); }
+
+  [[nodiscard]] uint64_t Budget() const { return budget_; }
+  void SetBudget(const uint64_t budget) { budget_ = budget; }
+  [[nodiscard]] uint64_t ResidentBytes() const { return resident_bytes_; }
+  [[nodiscard]] uint64_t TotalBytes() const { return total_bytes_; }
+
+private:
+  struct Texture
+  {
+    TextureFormat format{};
+    std::vector<TextureMip> mips; // empty once removed
+    std::unique_ptr<VulkanImage> image;
+    std::unique_ptr<VulkanImage> loading; // replaces image once its upload is done
+    uint32_t loading_level{};
+    uint64_t loading_upload{};
+    std::span<const std::byte> data; // into storage or whatever owner holds
+    std::vector<std::byte> storage;
+    std::shared_ptr<const void> owner;
+    uint32_t tail{}; // coarsest level that is always resident
+    uint32_t resident{}; // finest level on the gpu
+    uint32_t requested{}; // finest level the last feedback asked for
+    uint32_t last_seen{}; // update the texture was last in the feedback
+  };
+
+  struct RetiredImage
+  {
+    std::unique_ptr<VulkanImage> image;
+    uint32_t frames_left{};
+    uint64_t upload{}; // the copy into it
+  };
+
+  // Bytes of the levels from first down to the last one.
+  [[nodiscard]] static uint64_t ChainBytes(const Texture& texture, uint32_t first);
+  // Records the upload of an image holding the levels from first down. It's the texture's image right away if it
+  // doesn't have one yet, otherwise it's loading until the upload is done.
+  void MakeResident(uint32_t index, uint32_t first);
+  // Swaps in the loading images whose uploads are done.
+  void FinishLoads();
+
+  std::vector<Texture> textures_;
+  std::vector<uint32_t> free_; // ids of removed textures
+  std::vector<uint32_t> pending_; // added since the last Upload
+  std::vector<uint32_t> changed_;
+
+  std::vector<RetiredImage> retired_;
+  uint32_t frames_in_flight_;
+  uint32_t capacity_;
+  uint32_t update_count_ = 0;
+
+  uint64_t budget_;
+  uint64_t resident_bytes_ = 0;
+  uint64_t total_bytes_ = 0; // of every full mip chain
+
+  VulkanDevice* device_;
+  VulkanAllocator* allocator_;
+  VulkanUploadQueue* uploads_;
+  std::vector<uint32_t> queue_families_; // written on the transfer queue, sampled on the graphics one
+};
@@ -0,0 +1,184 @@
+#include "render/vk_upload_queue.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "render/vk_buffer.hpp"
+#include "render/vk_command_pool.hpp"
+#include "render/vk_device.hpp"
+#include "tracy/Tracy.hpp"
+#include "vk_allocator.hpp"
+
+namespace
+{
+  BufferInfo StagingInfo(const vk::DeviceSize size)
+  {
+    return {.size = size,
+            .usage = vk::BufferUsageFlagBits::eTransferSrc,
+            .memoryUsage = VMA_MEMORY_USAGE_AUTO,
+            .memoryFlags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT};
+  }
+} // namespace
+
+VulkanUploadQueue::VulkanUploadQueue(VulkanDevice* device, VulkanAllocator* allocator,
+                                     const VulkanCommandPool* transfer_pool, const vk::DeviceSize staging_size) :
+    device_(device), allocator_(allocator), transfer_pool_(transfer_pool)
+{
+  vk::SemaphoreTypeCreateInfo type_info{.semaphoreType = vk::SemaphoreType::eTimeline, .initialValue = 0};
+  const vk::SemaphoreCreateInfo create_info{.pNext = &type_info};
+  semaphore_ = device_->get().createSemaphoreUnique(create_info);
+
+  const auto ring_size = staging_size / kStagingAlignment * kStagingAlignment;
+  ring_ = std::make_unique<VulkanBuffer>(StagingInfo(ring_size), allocator_->get(), device_);
+}
+
+VulkanUploadQueue::~VulkanUploadQueue()
+{
+  // a batch that never got submitted still owns its command buffer
+  if (recording_.cmd)
+  {
+    recording_.cmd.end();
+    transfer_pool_->free(recording_.cmd);
+  }
+
+  const auto semaphore = semaphore_.get();
+  const vk::SemaphoreWaitInfo wait_info{.semaphoreCount = 1, .pSemaphores = &semaphore, .pValues = &submitted_};
+  static_cast<void>(device_->get().waitSemaphores(wait_info, UINT64_MAX));
+  Collect();
+}
+
+vk::CommandBuffer VulkanUploadQueue::Record()
+{
+  if (!recording_.cmd)
+  {
+    recording_.cmd = transfer_pool_->allocate();
+    constexpr vk::CommandBufferBeginInfo info{.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit};
+    recording_.cmd.begin(info);
+  }
+  return recording_.cmd;
+}
+
+VulkanUploadQueue::Staged VulkanUploadQueue::Stage(const std::span<const std::byte> data)
+{
+  if (data.empty())
+  {
+    return {};
+  }
+
+  static_cast<void>(Record());
+
+  auto offset = AllocateRing(data.size());
+  if (!offset)
+  {
+    // the ring may only be full of batches that finished since the last Collect
+    Collect();
+    offset = AllocateRing(data.size());
+  }
+
+  if (offset)
+  {
+    std::memcpy(ring_->GetMappedDataAs<std::byte>() + *offset, data.data(), data.size());
+    ring_->Flush(*offset, data.size());
+    return {.buffer = ring_->get(), .offset = *offset};
+  }
+
+  // too big for the ring or the gpu is behind, a buffer of its own is slower but never waits
+  auto buffer = std::make_unique<VulkanBuffer>(StagingInfo(data.size()), allocator_->get(), device_);
+  std::memcpy(buffer->GetMappedData(), data.data(), data.size());
+  buffer->Flush(0, data.size());
+  const Staged staged{.buffer = buffer->get(), .offset = 0};
+  Keep(std::move(buffer));
+  return staged;
+}
+
+std::optional<vk::DeviceSize> VulkanUploadQueue::AllocateRing(const vk::DeviceSize size)
+{
+  const uint64_t capacity = ring_->size();
+  if (size > capacity)
+  {
+    return std::nullopt;
+  }
+
+  auto start = (ring_head_ + kStagingAlignment - 1) / kStagingAlignment * kStagingAlignment;
+  // an allocation never wraps, the end of the ring is skipped instead
+  if (start % capacity + size > capacity)
+  {
+    start += capacity - start % capacity;
+  }
+  if (start + size - ring_tail_ > capacity)
+  {
+    return std::nullopt;
+  }
+
+  ring_head_ = start + size;
+  return start % capacity;
+}
+
+uint64_t VulkanUploadQueue::StagingSize() const { return ring_->size(); }
+
+void VulkanUploadQueue::Keep(std::unique_ptr<VulkanBuffer> buffer) { recording_.kept.push_back(std::move(buffer)); }
+
+void VulkanUploadQueue::Submit()
+{
+  if (!recording_.cmd)
+  {
+    return;
+  }
+
+  ZoneScopedN("VulkanUploadQueue::Submit");
+
+  recording_.cmd.end();
+  recording_.value = RecordingValue();
+  recording_.ring_end = ring_head_;
+
+  const vk::CommandBufferSubmitInfo cmd_info{.commandBuffer = recording_.cmd};
+  // signals once every command in the batch is done
+  const vk::SemaphoreSubmitInfo signal_info{
+      .semaphore = semaphore_.get(), .value = recording_.value, .stageMask = vk::PipelineStageFlagBits2::eAllCommands};
+  const vk::SubmitInfo2 submit_info{.commandBufferInfoCount = 1,
+                                    .pCommandBufferInfos = &cmd_info,
+                                    .signalSemaphoreInfoCount = 1,
+                                    .pSignalSemaphoreInfos = &signal_info};
+
+  const auto result = device_->TransferQueue().submit2(1, &submit_info, nullptr);
+  if (result != vk::Result::eSuccess)
+  {
+    throw std::runtime_error("Failed to submit to transfer queue: " + vk::to_string(result));
+  }
+
+  submitted_ = recording_.value;
+  in_flight_.push_back(std::move(recording_));
+  recording_ = {};
+}
+
+void VulkanUploadQueue::Collect()
+{
+  std::erase_if(in_flight_,
+                [this](const Batch& batch)
+                {
+                  if (!Done(batch.value))
+                  {
+                    return false;
+                  }
+                  transfer_pool_->free(batch.cmd);
+                  // batches finish in order
+                  ring_tail_ = std::max(ring_tail_, batch.ring_end);
+                  return true;
+                });
+}
+
+bool VulkanUploadQueue::Done(const uint64_t value) const
+{
+  if (value <= completed_)
+  {
+    return true;
+  }
+  // nothing unsubmitted is ever done
+  if (value > submitted_)
+  {
+    return false;
+  }
+  completed_ = device_->get().getSemaphoreCounterValue(semaphore_.get());
+  return value <= completed_;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+class VulkanAllocator;
+class VulkanBuffer;
+class VulkanCommandPool;
+class VulkanDevice;
+
+// Batches copies onto the transfer queue without ever waiting for them on the cpu. Everything recorded between two
+// Submits goes out as one submission that signals the next value of a timeline semaphore, a value is done once the gpu
+// got through everything recorded up to it. Buffers handed to Keep stay alive until their batch is done.
+//
+// Copy sources come out of one persistently mapped staging ring. Batches take space from it in order and give it back
+// once they're done, so nothing gets allocated or mapped per upload. Whatever doesn't fit gets a buffer of its own.
+class VulkanUploadQueue
+{
+public:
+  struct Staged
+  {
+    vk::Buffer buffer;
+    vk::DeviceSize offset{};
+  };
+
+  VulkanUploadQueue(VulkanDevice* device, VulkanAllocator* allocator, const VulkanCommandPool* transfer_pool,
+                    vk::DeviceSize staging_size);
+  VulkanUploadQueue(const VulkanUploadQueue&) = delete;
+  VulkanUploadQueue(VulkanUploadQueue&&) = delete;
+  VulkanUploadQueue& operator=(const VulkanUploadQueue&) = delete;
+  VulkanUploadQueue& operator=(VulkanUploadQueue&&) = delete;
+  ~VulkanUploadQueue();
+
+  // The batch being recorded, begun on first use. It may overlap the batches before it, copies that read what an
+  // earlier one wrote need a barrier.
+  [[nodiscard]] vk::CommandBuffer Record();
+  // Copies data to staging memory the batch being recorded can copy from, it stays valid until the batch is done.
+  // Offsets are aligned for copies into block compressed images.
+  [[nodiscard]] Staged Stage(std::span<const std::byte> data);
+  // Keeps buffer alive until the batch being recorded is done, for copy sources.
+  void Keep(std::unique_ptr<VulkanBuffer> buffer);
+  // The next frame reads what's done at value, it has to wait for it on the gpu.
+  void Require(const uint64_t value) { required_ = std::max(required_, value); }
+
+  // Submits the batch being recorded, if anything was.
+  void Submit();
+  // Frees the command buffers and kept buffers of the batches that are done.
+  void Collect();
+
+  // What the batch being recorded will signal.
+  [[nodiscard]] uint64_t RecordingValue() const { return submitted_ + 1; }
+  // The last value the next frame has to wait for.
+  [[nodiscard]] uint64_t RequiredValue() const { return required_; }
+  [[nodiscard]] bool Done(uint64_t value) const;
+  [[nodiscard]] vk::Semaphore Semaphore() const { return semaphore_.get(); }
+  // Bytes of the staging ring batches that aren't done yet still hold.
+  [[nodiscard]] uint64_t StagingUsed() const { return ring_head_ - ring_tail_; }
+  [[nodiscard]] uint64_t StagingSize() const;
+
+private:
+  static constexpr vk::DeviceSize kStagingAlignment = 16; // the biggest texel block
+
+  struct Batch
+  {
+    uint64_t value{};
+    vk::CommandBuffer cmd;
+    std::vector<std::unique_ptr<VulkanBuffer>> kept;
+    uint64_t ring_end{}; // ring_head_ when it was submitted
+  };
+
+  [[nodiscard]] std::optional<vk::DeviceSize> AllocateRing(vk::DeviceSize size);
+
+  Batch recording_;
+  std::vector<Batch> in_flight_;
+  uint64_t submitted_ = 0;
+  uint64_t required_ = 0;
+  mutable uint64_t completed_ = 0; // last value the semaphore was seen at
+
+  // Both count every byte ever taken from the ring, the position in it is the count modulo its size.
+  std::unique_ptr<VulkanBuffer> ring_;
+  uint64_t ring_head_ = 0;
+  uint64_t ring_tail_ = 0; // everything before it belongs to done batches
+
+  vk::UniqueSemaphore semaphore_;
+  VulkanDevice* device_;
+  VulkanAllocator* allocator_;
+  const VulkanCommandPool* transfer_pool_;
+};
@@ -1,12 +1,25 @@
 #pragma once
 #include <cassert>
 #include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "core/job_system.hpp"
 #include "resource_callback.hpp"
+#include "util/print.hpp"
+
+enum class ResourceState : uint8_t
+{
+  kReady,
+  kPending,
+  kFailed
+};
 
 template<typename T>
 class ResourceStorage;
@@ -66,6 +79,10 @@ public:
   [[nodiscard]] bool valid() const { return storage_ != nullptr; }
   explicit operator bool() const { return valid(); }
 
+  // Async loads hand out handles before the resource exists, only dereference ready handles.
+  [[nodiscard]] ResourceState state() const { return storage_->states_.at(index_); }
+  [[nodiscard]] bool ready() const { return valid() && state() == ResourceState::kReady; }
+
 private:
   friend class ResourceStorage<T>;
 
@@ -89,6 +106,13 @@ private:
 template<typename Loader, typename T, typename... Args>
 concept LoaderFor = std::invocable<Loader, Args...> && std::same_as<std::invoke_result_t<Loader, Args...>, T>;
 
+// concept for async loaders. Load runs on a worker thread and returns whatever
+// it wants, Finalize turns that into the resource on the main thread.
+template<typename Loader, typename T, typename... Args>
+concept AsyncLoaderFor = requires(const Loader& loader, Args&... args) {
+  { loader.Finalize(loader.Load(args...)) } -> std::same_as<T>;
+};
+
 template<typename T>
 class ResourceStorage
 {
@@ -98,11 +122,19 @@ class ResourceStorage
   std::vector<T> resources_;
   std::vector<uint32_t> ref_counts_;
   std::vector<std::string> keys_;
+  std::vector<ResourceState> states_;
+  std::vector<uint64_t> tickets_; // identifies the async load a slot is waiting for
   std::vector<uint32_t> free_;
 
   std::unordered_map<std::string, uint32_t> key_to_index_;
 
   std::vector<ResourceCallback<T>> on_destroy_;
+  std::vector<ResourceCallback<T>> on_load_;
+
+  // Written by load workers, drained on the main thread in Update
+  std::mutex completed_mutex_;
+  std::vector<std::function<void()>> completed_;
+  uint64_t next_ticket_ = 0;
 
   void acquire(const uint32_t index) { ++ref_counts_.at(index); }
 
@@ -111,11 +143,20 @@ class ResourceStorage
     assert(ref_counts_.at(index) > 0);
     if (--ref_counts_.at(index) == 0)
     {
-      for (const auto& callback: on_destroy_)
+      if (states_.at(index) == ResourceState::kReady)
+      {
+        for (const auto& callback: on_destroy_)
+        {
+          callback(resources_[index]);
+        }
+      }
+      // a load still in flight for this slot gets dropped when it finishes
+      tickets_.at(index) = 0;
+      // a failed slot already gave its key up, it may belong to a retry by now
+      if (const auto iter = key_to_index_.find(keys_.at(index)); iter != key_to_index_.end() && iter->second == index)
       {
-        callback(resources_[index]);
+        key_to_index_.erase(iter);
       }
-      key_to_index_.erase(keys_.at(index));
       keys_.at(index).clear();
       // resources_[index] = T{};
       // could destroy resource here but why not leave it, gets destroyed when
@@ -132,13 +173,132 @@ public:
     auto iter = key_to_index_.find(key);
     if (iter != key_to_index_.end())
     {
-      ++ref_counts_.at(iter->second);
-      return Handle{iter->second, this};
+      const uint32_t index = iter->second;
+      // the caller gets to use the resource right away, so a pending slot is loaded here and the async load that's
+      // still in flight gets dropped when it finishes
+      if (states_.at(index) == ResourceState::kPending)
+      {
+        resources_[index] = std::forward<Loader>(loader)(std::forward<Args>(args)...);
+        states_.at(index) = ResourceState::kReady;
+        tickets_.at(index) = 0;
+        for (const auto& callback: on_load_)
+        {
+          callback(resources_[index]);
+        }
+      }
+      ++ref_counts_.at(index);
+      return Handle{index, this};
     }
 
     // load before touching indices because might throw exception
     T resource = std::forward<Loader>(loader)(std::forward<Args>(args)...);
 
+    const uint32_t index = emplace(key, std::move(resource), ResourceState::kReady);
+    for (const auto& callback: on_load_)
+    {
+      callback(resources_[index]);
+    }
+
+    return Handle{index, this};
+  }
+
+  // Returns a pending handle right away and runs loader.Load on the job system. The
+  // resource becomes ready in the Update call after the worker is done.
+  // Requests for a key that is already loaded or loading share that slot, a failed key
+  // is loaded again into a fresh one.
+  template<typename Loader, typename... Args>
+    requires AsyncLoaderFor<Loader, T, Args...>
+  Handle LoadAsync(JobSystem& jobs, const std::string& key, Loader loader, Args... args)
+  {
+    auto iter = key_to_index_.find(key);
+    if (iter != key_to_index_.end())
+    {
+      ++ref_counts_.at(iter->second);
+      return Handle{iter->second, this};
+    }
+
+    const uint32_t index = emplace(key, T{}, ResourceState::kPending);
+    const uint64_t ticket = ++next_ticket_;
+    tickets_.at(index) = ticket;
+
+    jobs.Submit(
+        [this, index, ticket, loader = std::move(loader), ... args = std::move(args)]() mutable
+        {
+          std::function<void()> finish;
+          try
+          {
+            using Intermediate = decltype(loader.Load(args...));
+            auto intermediate = std::make_shared<Intermediate>(loader.Load(args...));
+            finish = [this, index, ticket, loader, intermediate]
+            {
+              if (tickets_.at(index) != ticket)
+              {
+                return;
+              }
+              try
+              {
+                resources_[index] = loader.Finalize(std::move(*intermediate));
+              } catch (const std::exception& err)
+              {
+                fail(index, err.what());
+                return;
+              }
+              states_.at(index) = ResourceState::kReady;
+              for (const auto& callback: on_load_)
+              {
+                callback(resources_[index]);
+              }
+            };
+          } catch (const std::exception& err)
+          {
+            finish = [this, index, ticket, message = std::string(err.what())]
+            {
+              if (tickets_.at(index) == ticket)
+              {
+                fail(index, message);
+              }
+            };
+          }
+
+          const std::scoped_lock lock(completed_mutex_);
+          completed_.push_back(std::move(finish));
+        });
+
+    return Handle{index, this};
+  }
+
+  // Finishes async loads, call on the main thread.
+  void Update()
+  {
+    std::vector<std::function<void()>> completed;
+    {
+      const std::scoped_lock lock(completed_mutex_);
+      completed.swap(completed_);
+    }
+
+    for (const auto& finish: completed)
+    {
+      finish();
+    }
+  }
+
+  Handle get(const std::string& key)
+  {
+    auto iter = key_to_index_.find(key);
+    if (iter == key_to_index_.end())
+    {
+      return {};
+    }
+    ++ref_counts_.at(iter->second);
+    return Handle{iter->second, this};
+  }
+
+  void AddOnDestroyCallback(const ResourceCallback<T>& callback) { on_destroy_.push_back(callback); }
+  void AddOnLoadCallback(const ResourceCallback<T>& callback) { on_load_.push_back(callback); }
+
+private:
+  uint32_t emplace(const std::string& key, T&& resource, const ResourceState state)
+  {
     uint32_t index{};
     if (!free_.empty())
     {
@@ -151,25 +311,24 @@ public:
       resources_.push_back(std::move(resource));
       ref_counts_.emplace_back();
       keys_.emplace_back();
+      states_.emplace_back();
+      tickets_.emplace_back();
     }
 
     ref_counts_.at(index) = 1;
     keys_.at(index) = key;
+    states_.at(index) = state;
+    tickets_.at(index) = 0;
     key_to_index_[key] = index;
 
-    return Handle{index, this};
+    return index;
   }
 
-  Handle get(const std::string& key)
+  void fail(const uint32_t index, const std::string& message)
   {
-    auto iter = key_to_index_.find(key);
-    if (iter == key_to_index_.end())
-    {
-      return {};
-    }
-    ++ref_counts_.at(iter->second);
-    return Handle{iter->second, this};
+    states_.at(index) = ResourceState::kFailed;
+    util::println("Failed to load {}: {}", keys_.at(index), message);
+    // the handles out there keep the failed slot, the next load of the key tries again
+    key_to_index_.erase(keys_.at(index));
   }
-
-  void AddOnDestroyCallback(const ResourceCallback<T>& callback) { on_destroy_.push_back(callback); }
 };
@@ -3,6 +3,7 @@
 #include <filesystem>
 #include <tuple>
 
+#include "core/job_system.hpp"
 #include "files/files.hpp"
 #include "resource.hpp"
 #include "resource/types/mesh_resource.hpp"
@@ -11,7 +12,7 @@
 class ResourceManager
 {
 public:
-  ResourceManager() { root_path_ = files::GetAssetsPathRoot(); }
+  explicit ResourceManager(JobSystem &jobs) : jobs_(&jobs) { root_path_ = files::GetAssetsPathRoot(); }
 
   template<typename T>
   ResourceStorage<T> &GetStorage()
@@ -38,8 +39,22 @@ public:
     return GetStorage<T>().load(key, std::forward<Loader>(loader), full_path, std::forward<Args>(args)...);
   }
 
+  template<typename T, typename Loader, typename... Args>
+  ResourceHandle<T> LoadAsync(const std::string &key, Loader loader, Args... args)
+  {
+    return GetStorage<T>().LoadAsync(*jobs_, key, std::move(loader), std::move(args)...);
+  }
+
+  // Finishes async loads that are done, call once per frame on the main thread.
+  void Update()
+  {
+    std::apply([](auto &...storage) { (storage.Update(), ...); }, storages_);
+  }
+
 private:
   std::tuple<ResourceStorage<ShaderResource>, ResourceStorage<MeshResource>> storages_;
+  // loads write to storages_ when they finish, the owner has to join the workers before destroying this
+  JobSystem *jobs_;
 
   std::filesystem::path root_path_;
 };
@@ -0,0 +1,119 @@
+#include "resource/types/mesh_format.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#include "resource/types/mesh_resource.hpp"
+#include "tracy/Tracy.hpp"
+
+namespace
+{
+  uint64_t AlignUp(const uint64_t value)
+  {
+    return (value + mesh_format::kSectionAlignment - 1) & ~(mesh_format::kSectionAlignment - 1);
+  }
+
+  template<typename T>
+  std::span<const T> GetSection(const std::span<const std::byte> file, const mesh_format::Section& section)
+  {
+    if (section.offset + section.size > file.size() || section.size % sizeof(T) != 0)
+    {
+      throw std::runtime_error("Cooked mesh section out of bounds");
+    }
+    return {reinterpret_cast<const T*>(file.data() + section.offset), section.size / sizeof(T)};
+  }
+} // namespace
+
+void mesh_format::Write(const std::string& path, const MeshData& data)
+{
+  ZoneScopedN("mesh_format::Write");
+
+  Header header{.magic = kMagic,
+                .version = kVersion,
+                .vertex_format = data.vertex_format,
+                .position_stride = PositionStride(data.vertex_format),
+                .attribute_stride = AttributeStride(data.vertex_format),
+                .b_min = data.b_min,
+                .b_max = data.b_max,
+                .texture_path = {},
+                .vertex_positions = {},
+                .vertex_attributes = {},
+                .indices = {},
+                .meshlets = {},
+                .lods = {}};
+
+  uint64_t offset = AlignUp(sizeof(Header));
+  const auto place = [&offset](Section& section, const uint64_t size)
+  {
+    section = {.offset = offset, .size = size};
+    offset = AlignUp(offset + size);
+  };
+  place(header.texture_path, data.texture_path.size());
+  place(header.vertex_positions, data.vertex_positions.size_bytes());
+  place(header.vertex_attributes, data.vertex_attributes.size_bytes());
+  place(header.indices, data.indices.size_bytes());
+  place(header.meshlets, data.meshlets.size_bytes());
+  place(header.lods, data.lods.size_bytes());
+
+  std::vector<std::byte> bytes(offset);
+  std::memcpy(bytes.data(), &header, sizeof(Header));
+  std::memcpy(bytes.data() + header.texture_path.offset, data.texture_path.data(), header.texture_path.size);
+  std::memcpy(bytes.data() + header.vertex_positions.offset, data.vertex_positions.data(),
+              header.vertex_positions.size);
+  std::memcpy(bytes.data() + header.vertex_attributes.offset, data.vertex_attributes.data(),
+              header.vertex_attributes.size);
+  std::memcpy(bytes.data() + header.indices.offset, data.indices.data(), header.indices.size);
+  std::memcpy(bytes.data() + header.meshlets.offset, data.meshlets.data(), header.meshlets.size);
+  std::memcpy(bytes.data() + header.lods.offset, data.lods.data(), header.lods.size);
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+  if (!file)
+  {
+    throw std::runtime_error("Failed to write cooked mesh " + path);
+  }
+}
+
+void mesh_format::Read(files::MappedFile file, MeshData& data)
+{
+  ZoneScopedN("mesh_format::Read");
+
+  const auto bytes = file.data();
+  if (bytes.size() < sizeof(Header))
+  {
+    throw std::runtime_error("Cooked mesh too small");
+  }
+
+  Header header{};
+  std::memcpy(&header, bytes.data(), sizeof(Header));
+  if (header.magic != kMagic || header.version != kVersion ||
+      (header.vertex_format != VertexFormat::kFull && header.vertex_format != VertexFormat::kQuantized) ||
+      header.position_stride != PositionStride(header.vertex_format) ||
+      header.attribute_stride != AttributeStride(header.vertex_format))
+  {
+    throw std::runtime_error("Cooked mesh has the wrong version");
+  }
+
+  const auto texture_path = GetSection<char>(bytes, header.texture_path);
+  data.texture_path.assign(texture_path.begin(), texture_path.end());
+  data.vertex_format = header.vertex_format;
+  data.vertex_positions = GetSection<std::byte>(bytes, header.vertex_positions);
+  data.vertex_attributes = GetSection<std::byte>(bytes, header.vertex_attributes);
+  if (data.vertex_positions.size() % header.position_stride != 0 ||
+      data.vertex_attributes.size() != data.VertexCount() * header.attribute_stride)
+  {
+    throw std::runtime_error("Cooked mesh section out of bounds");
+  }
+  data.indices = GetSection<uint32_t>(bytes, header.indices);
+  data.meshlets = GetSection<Meshlet>(bytes, header.meshlets);
+  data.lods = GetSection<MeshLod>(bytes, header.lods);
+  if (data.lods.empty())
+  {
+    throw std::runtime_error("Cooked mesh has no lods");
+  }
+  data.b_min = header.b_min;
+  data.b_max = header.b_max;
+  data.file = std::move(file);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+
+#include "files/files.hpp"
+#include "render/vk_renderer.hpp"
+
+struct MeshData;
+
+// Cooked mesh container (.pmesh). Laid out so the runtime can map the file and
+// hand the vertex and index arrays straight to the renderer:
+//
+//   Header | texture path | vertex positions | vertex attributes | indices | meshlets | lods
+//
+// every section starts at a kSectionAlignment aligned offset from the start of the file.
+namespace mesh_format
+{
+  inline constexpr std::array<char, 4> kMagic{'P', 'M', 'S', 'H'};
+  inline constexpr uint32_t kVersion = 6;
+  inline constexpr uint64_t kSectionAlignment = 16;
+  inline constexpr const char* kExtension = ".pmesh";
+
+  struct Section
+  {
+    uint64_t offset;
+    uint64_t size; // in bytes
+  };
+
+  struct Header
+  {
+    std::array<char, 4> magic;
+    uint32_t version;
+    VertexFormat vertex_format;
+    // of the format when cooked, a mismatch means the file is stale
+    uint32_t position_stride;
+    uint32_t attribute_stride;
+    uint32_t padding{};
+
+    glm::vec3 b_min;
+    glm::vec3 b_max;
+
+    Section texture_path;
+    Section vertex_positions;
+    Section vertex_attributes;
+    Section indices;
+    Section meshlets;
+    Section lods;
+  };
+
+  // Throws on io errors.
+  void Write(const std::string& path, const MeshData& data);
+
+  // Points data's spans into the mapping and takes ownership of it. Throws if the file isn't a valid cooked mesh of the
+  // current version.
+  void Read(files::MappedFile file, MeshData& data);
+} // namespace mesh_format
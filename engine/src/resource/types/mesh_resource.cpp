@@ -1,25 +1,89 @@
 #include "ecs/components/mesh_component.hpp"
 
+#include <algorithm>
+#include <glm/gtc/packing.hpp>
 #include <limits>
+#include <meshoptimizer.h>
+#include <unordered_map>
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tinyobjloader/tiny_obj_loader.h>
 
 #include "core/engine.hpp"
 #include "files/files.hpp"
-
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+#include "resource/types/mesh_format.hpp"
+#include "tracy/Tracy.hpp"
 #include "util/print.hpp"
 
-MeshResource MeshResourceLoader::operator()(const std::string &path, Engine *engine) const
+constexpr size_t kMeshletMaxVertices = 64;
+constexpr size_t kMeshletMaxTriangles = 124;
+constexpr float kMeshletConeWeight = 0.25F;
+
+constexpr uint32_t kVertexCacheSize = 16;
+constexpr float kOverdrawThreshold = 1.05F; // how much worse the vertex cache may get for less overdraw
+
+constexpr size_t kMaxLods = 8;
+constexpr size_t kMinLodIndexCount = 3 * 32;
+constexpr float kMinLodReduction = 0.85F; // a level needs to drop at least 15% of the previous level's triangles
+constexpr float kLodMaxError = 0.1F; // relative to the mesh extent
+
+namespace
 {
-  MeshResource res{};
+  struct ObjIndexHash
+  {
+    size_t operator()(const tinyobj::index_t &index) const
+    {
+      // indices are small, mixing them as 64 bit keeps collisions rare
+      uint64_t key = static_cast<uint32_t>(index.vertex_index);
+      key = (key * 0x9E3779B97F4A7C15ULL) ^ static_cast<uint32_t>(index.normal_index);
+      key = (key * 0x9E3779B97F4A7C15ULL) ^ static_cast<uint32_t>(index.texcoord_index);
+      return std::hash<uint64_t>{}(key);
+    }
+  };
+
+  struct ObjIndexEqual
+  {
+    bool operator()(const tinyobj::index_t &lhs, const tinyobj::index_t &rhs) const
+    {
+      return lhs.vertex_index == rhs.vertex_index && lhs.normal_index == rhs.normal_index &&
+             lhs.texcoord_index == rhs.texcoord_index;
+    }
+  };
+
+  std::string GetTexturePath(const std::string &texture_name)
+  {
+    return files::GetAssetsPathRoot().string() + "/engine/assets/" + texture_name;
+  }
+
+  // folds the lower hemisphere over the upper one, every direction ends up in [-1, 1]^2
+  glm::vec2 OctEncode(const glm::vec3 &normal)
+  {
+    const float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    if (length == 0.0F)
+    {
+      return glm::vec2(0.0F);
+    }
+
+    const glm::vec3 n = normal / length;
+    if (n.z >= 0.0F)
+    {
+      return {n.x, n.y};
+    }
+    const glm::vec2 sign(n.x >= 0.0F ? 1.0F : -1.0F, n.y >= 0.0F ? 1.0F : -1.0F);
+    return (1.0F - glm::abs(glm::vec2(n.y, n.x))) * sign;
+  }
+} // namespace
+
+MeshData LoadObjMeshData(const std::string &path, const VertexFormat format)
+{
+  ZoneScopedN("LoadObjMeshData");
+
+  MeshData data{};
   std::vector<tinyobj::shape_t> shapes;
   std::vector<tinyobj::material_t> materials;
   tinyobj::attrib_t attrib;
 
-  std::vector<Vertex> vertices;
-  std::vector<uint32_t> indices;
+  auto &vertices = data.vertex_storage;
+  auto &indices = data.index_storage;
 
   std::string err;
   std::string warn;
@@ -33,10 +97,27 @@ MeshResource MeshResourceLoader::operator()(const std::string &path, Engine *eng
   auto b_min = glm::vec3(std::numeric_limits<float>::max());
   auto b_max = -b_min;
 
+  // OBJ indexes position, normal and uv separately, every distinct combination becomes one vertex
+  std::unordered_map<tinyobj::index_t, uint32_t, ObjIndexHash, ObjIndexEqual> unique_vertices;
+  size_t index_count{};
+  for (const auto &shape: shapes)
+  {
+    index_count += shape.mesh.indices.size();
+  }
+  unique_vertices.reserve(index_count);
+  indices.reserve(index_count);
+
   for (const auto &shape: shapes)
   {
     for (const auto &index: shape.mesh.indices)
     {
+      const auto [iter, inserted] = unique_vertices.try_emplace(index, static_cast<uint32_t>(vertices.size()));
+      indices.push_back(iter->second);
+      if (!inserted)
+      {
+        continue;
+      }
+
       const glm::vec3 pos = {attrib.vertices[index.vertex_index * 3], attrib.vertices[(index.vertex_index * 3) + 1],
                              attrib.vertices[(index.vertex_index * 3) + 2]};
 
@@ -64,51 +145,360 @@ MeshResource MeshResourceLoader::operator()(const std::string &path, Engine *eng
       }
 
       vertices.push_back({.position = pos, .color = col, .normal = nor, .tex_coord = tex_coord});
-      indices.push_back(static_cast<uint32_t>(vertices.size() - 1));
     }
   }
 
-  const unsigned char *texture{};
-  int32_t texture_width{};
-  int32_t texture_height{};
-  int32_t texture_channels{};
+  const auto stats = OptimizeMesh(data);
+  util::println("Optimized {}: ACMR {:.2f} -> {:.2f}, ATVR {:.2f} -> {:.2f}, overdraw {:.2f} -> {:.2f}", path,
+                stats.acmr_before, stats.acmr_after, stats.atvr_before, stats.atvr_after, stats.overdraw_before,
+                stats.overdraw_after);
+
+  GenerateLods(data);
+  BuildMeshlets(data);
+  data.b_min = b_min;
+  data.b_max = b_max;
+  EncodeVertices(data, format);
+
   for (const auto &material: materials)
   {
     if (!material.diffuse_texname.empty())
     {
-      const auto tex_path = files::GetAssetsPathRoot().string() + "/engine/assets/" + material.diffuse_texname;
-      if (!std::filesystem::exists(tex_path))
+      if (!std::filesystem::exists(GetTexturePath(material.diffuse_texname)))
       {
         util::println("Failed to find texture");
         continue;
       }
 
+      data.texture_path = material.diffuse_texname;
+    }
+  }
+
+  return data;
+}
+
+MeshOptimizationStats OptimizeMesh(MeshData &data)
+{
+  ZoneScopedN("OptimizeMesh");
+
+  auto &vertices = data.vertex_storage;
+  auto &indices = data.index_storage;
+  MeshOptimizationStats stats{};
+  if (indices.empty())
+  {
+    return stats;
+  }
+
+  const auto analyze = [&](float &acmr, float &atvr, float &overdraw)
+  {
+    const auto cache =
+        meshopt_analyzeVertexCache(indices.data(), indices.size(), vertices.size(), kVertexCacheSize, 0, 0);
+    acmr = cache.acmr;
+    atvr = cache.atvr;
+    overdraw = meshopt_analyzeOverdraw(indices.data(), indices.size(), &vertices.data()->position.x, vertices.size(),
+                                       sizeof(Vertex))
+                   .overdraw;
+  };
+  analyze(stats.acmr_before, stats.atvr_before, stats.overdraw_before);
+
+  meshopt_optimizeVertexCache(indices.data(), indices.data(), indices.size(), vertices.size());
+  meshopt_optimizeOverdraw(indices.data(), indices.data(), indices.size(), &vertices.data()->position.x,
+                           vertices.size(), sizeof(Vertex), kOverdrawThreshold);
+  // vertices in the order the triangles first use them, also drops vertices no triangle references
+  const size_t vertex_count = meshopt_optimizeVertexFetch(vertices.data(), indices.data(), indices.size(),
+                                                          vertices.data(), vertices.size(), sizeof(Vertex));
+  vertices.resize(vertex_count);
+
+  analyze(stats.acmr_after, stats.atvr_after, stats.overdraw_after);
+  return stats;
+}
+
+void GenerateLods(MeshData &data)
+{
+  ZoneScopedN("GenerateLods");
+
+  const auto &vertices = data.vertex_storage;
+  auto &indices = data.index_storage;
+
+  data.lod_storage = {{.first_index = 0, .index_count = static_cast<uint32_t>(indices.size())}};
+  if (indices.empty())
+  {
+    data.lods = data.lod_storage;
+    return;
+  }
 
-      const auto *image =
-          stbi_load(tex_path.c_str(), &texture_width, &texture_height, &texture_channels, STBI_rgb_alpha);
+  const float *positions = &vertices.data()->position.x;
+  // simplify reports errors relative to the mesh extent, the culling shader wants object space
+  const float error_scale = meshopt_simplifyScale(positions, vertices.size(), sizeof(Vertex));
 
-      if (image == nullptr)
+  // every level is simplified from the full mesh so its error is against the original surface
+  const std::vector<uint32_t> source(indices.begin(), indices.end());
+  std::vector<uint32_t> lod_indices(source.size());
+  size_t target_index_count = source.size();
+
+  while (data.lod_storage.size() < kMaxLods)
+  {
+    target_index_count = target_index_count / 2 / 3 * 3;
+    if (target_index_count < kMinLodIndexCount)
+    {
+      break;
+    }
+
+    float error{};
+    const size_t lod_index_count =
+        meshopt_simplify(lod_indices.data(), source.data(), source.size(), positions, vertices.size(), sizeof(Vertex),
+                         target_index_count, kLodMaxError, 0, &error);
+
+    // not worth a level if it barely got smaller
+    const auto &previous = data.lod_storage.back();
+    const float max_index_count = kMinLodReduction * static_cast<float>(previous.index_count);
+    if (lod_index_count == 0 || static_cast<float>(lod_index_count) > max_index_count)
+    {
+      break;
+    }
+
+    meshopt_optimizeVertexCache(lod_indices.data(), lod_indices.data(), lod_index_count, vertices.size());
+    data.lod_storage.push_back({.first_index = static_cast<uint32_t>(indices.size()),
+                                .index_count = static_cast<uint32_t>(lod_index_count),
+                                .error = std::max(previous.error, error * error_scale)});
+    indices.insert(indices.end(), lod_indices.begin(), lod_indices.begin() + static_cast<ptrdiff_t>(lod_index_count));
+  }
+
+  data.indices = indices;
+  data.lods = data.lod_storage;
+}
+
+void BuildMeshlets(MeshData &data)
+{
+  ZoneScopedN("BuildMeshlets");
+
+  const auto &vertices = data.vertex_storage;
+  const auto &indices = data.index_storage;
+
+  // no mesh shaders, so meshlets are drawn as plain index ranges, expand the local triangles back into indices
+  std::vector<uint32_t> meshlet_indices;
+  meshlet_indices.reserve(indices.size());
+  data.meshlet_storage.clear();
+
+  for (auto &lod: data.lod_storage)
+  {
+    const uint32_t lod_first_index = static_cast<uint32_t>(meshlet_indices.size());
+    const uint32_t lod_meshlet_offset = static_cast<uint32_t>(data.meshlet_storage.size());
+    const std::span lod_indices(indices.data() + lod.first_index, lod.index_count);
+    if (lod_indices.empty())
+    {
+      lod = {.first_index = lod_first_index,
+             .index_count = 0,
+             .meshlet_offset = lod_meshlet_offset,
+             .meshlet_count = 0,
+             .error = lod.error};
+      continue;
+    }
+
+    const size_t max_meshlets =
+        meshopt_buildMeshletsBound(lod_indices.size(), kMeshletMaxVertices, kMeshletMaxTriangles);
+    std::vector<meshopt_Meshlet> meshlets(max_meshlets);
+    std::vector<uint32_t> meshlet_vertices(max_meshlets * kMeshletMaxVertices);
+    std::vector<uint8_t> meshlet_triangles(max_meshlets * kMeshletMaxTriangles * 3);
+
+    const size_t meshlet_count = meshopt_buildMeshlets(
+        meshlets.data(), meshlet_vertices.data(), meshlet_triangles.data(), lod_indices.data(), lod_indices.size(),
+        &vertices.data()->position.x, vertices.size(), sizeof(Vertex), kMeshletMaxVertices, kMeshletMaxTriangles,
+        kMeshletConeWeight);
+    meshlets.resize(meshlet_count);
+
+    for (const auto &meshlet: meshlets)
+    {
+      // meshlets are drawn as their own draws, so their triangles want the cache order within the meshlet
+      meshopt_optimizeMeshlet(&meshlet_vertices.at(meshlet.vertex_offset),
+                              &meshlet_triangles.at(meshlet.triangle_offset), meshlet.triangle_count,
+                              meshlet.vertex_count);
+
+      const auto bounds = meshopt_computeMeshletBounds(
+          &meshlet_vertices.at(meshlet.vertex_offset), &meshlet_triangles.at(meshlet.triangle_offset),
+          meshlet.triangle_count, &vertices.data()->position.x, vertices.size(), sizeof(Vertex));
+
+      data.meshlet_storage.push_back(
+          {.center = {bounds.center[0], bounds.center[1], bounds.center[2]},
+           .radius = bounds.radius,
+           .cone_apex = {bounds.cone_apex[0], bounds.cone_apex[1], bounds.cone_apex[2]},
+           .cone_axis = {bounds.cone_axis[0], bounds.cone_axis[1], bounds.cone_axis[2]},
+           .cone_cutoff = bounds.cone_cutoff,
+           .first_index = static_cast<uint32_t>(meshlet_indices.size()) - lod_first_index,
+           .index_count = meshlet.triangle_count * 3});
+
+      for (uint32_t i{}; i < meshlet.triangle_count * 3; i++)
       {
-        util::println("Failed to load texture");
-        continue;
+        const uint8_t local = meshlet_triangles.at(meshlet.triangle_offset + i);
+        meshlet_indices.push_back(meshlet_vertices.at(meshlet.vertex_offset + local));
+      }
+    }
+
+    lod = {.first_index = lod_first_index,
+           .index_count = static_cast<uint32_t>(meshlet_indices.size()) - lod_first_index,
+           .meshlet_offset = lod_meshlet_offset,
+           .meshlet_count = static_cast<uint32_t>(meshlet_count),
+           .error = lod.error};
+  }
+
+  data.index_storage = std::move(meshlet_indices);
+  data.indices = data.index_storage;
+  data.meshlets = data.meshlet_storage;
+  data.lods = data.lod_storage;
+}
+
+void EncodeVertices(MeshData &data, const VertexFormat format)
+{
+  ZoneScopedN("EncodeVertices");
+
+  const auto &vertices = data.vertex_storage;
+  data.vertex_format = format;
+  data.vertex_position_storage.resize(vertices.size() * PositionStride(format));
+  data.vertex_attribute_storage.resize(vertices.size() * AttributeStride(format));
+
+  if (format == VertexFormat::kFull)
+  {
+    auto *positions = reinterpret_cast<glm::vec3 *>(data.vertex_position_storage.data());
+    auto *attributes = reinterpret_cast<VertexAttributes *>(data.vertex_attribute_storage.data());
+    for (size_t i{}; i < vertices.size(); i++)
+    {
+      const auto &vertex = vertices[i];
+      positions[i] = vertex.position;
+      attributes[i] = {.color = vertex.color, .normal = vertex.normal, .tex_coord = vertex.tex_coord};
+    }
+  } else
+  {
+    // a flat axis quantizes to 0 instead of dividing by 0
+    const glm::vec3 extent = glm::max(data.b_max - data.b_min, glm::vec3(std::numeric_limits<float>::min()));
+    const glm::vec3 scale = glm::vec3(65535.0F) / extent;
+
+    auto *positions = reinterpret_cast<QuantizedPosition *>(data.vertex_position_storage.data());
+    auto *attributes = reinterpret_cast<QuantizedAttributes *>(data.vertex_attribute_storage.data());
+    for (size_t i{}; i < vertices.size(); i++)
+    {
+      const auto &vertex = vertices[i];
+      const glm::vec3 position = glm::round(glm::clamp((vertex.position - data.b_min) * scale, 0.0F, 65535.0F));
+      positions[i] = {.position = {static_cast<uint16_t>(position.x), static_cast<uint16_t>(position.y),
+                                   static_cast<uint16_t>(position.z)}};
+      attributes[i] = {.normal = glm::packSnorm2x8(OctEncode(vertex.normal)),
+                       .tex_coord = glm::packHalf2x16(vertex.tex_coord),
+                       .color = glm::packUnorm4x8(glm::vec4(vertex.color, 1.0F))};
+    }
+  }
+
+  data.vertex_positions = data.vertex_position_storage;
+  data.vertex_attributes = data.vertex_attribute_storage;
+  data.vertex_storage = {};
+}
+
+MeshData LoadCookedMeshData(const std::string &path)
+{
+  files::MappedFile file(path);
+  if (!file)
+  {
+    throw std::runtime_error("Failed to open " + path);
+  }
+
+  MeshData data{};
+  mesh_format::Read(std::move(file), data);
+  return data;
+}
+
+MeshData LoadMeshData(const std::string &path, const VertexFormat format, const bool block_compressed)
+{
+  ZoneScopedN("LoadMeshData");
+
+  const fs::path source(path);
+  MeshData data{};
+  if (source.extension() == mesh_format::kExtension)
+  {
+    data = LoadCookedMeshData(path);
+  } else
+  {
+    // use the cooked version when the cooker ran after the source was last touched
+    auto cooked = source;
+    cooked.replace_extension(mesh_format::kExtension);
+    std::error_code error;
+    const bool up_to_date =
+        fs::exists(cooked, error) && fs::last_write_time(cooked, error) >= fs::last_write_time(source, error);
+
+    bool loaded = false;
+    if (up_to_date && !error)
+    {
+      try
+      {
+        data = LoadCookedMeshData(cooked.string());
+        loaded = data.vertex_format == format;
+      } catch (const std::exception &err)
+      {
+        util::println("Ignoring cooked mesh {}: {}", cooked.string(), err.what());
       }
+    }
 
-      texture = image;
+    if (!loaded)
+    {
+      data = LoadObjMeshData(path, format);
     }
   }
 
+  LoadMeshTexture(data, block_compressed);
+  return data;
+}
+
+void LoadMeshTexture(MeshData &data, const bool block_compressed)
+{
+  if (data.texture_path.empty())
+  {
+    return;
+  }
+
+  try
+  {
+    data.texture = LoadTextureData(GetTexturePath(data.texture_path), block_compressed);
+  } catch (const std::exception &err)
+  {
+    util::println("Failed to load texture: {}", err.what());
+  }
+}
+
+MeshResource UploadMeshData(MeshData &&data, Engine *engine, const bool keep_cpu_copy)
+{
+  ZoneScopedN("UploadMeshData");
+
+  MeshResource res{};
   auto &renderer = engine->GetRenderer();
-  res.renderer_id =
-      renderer.AddMesh(vertices, indices, renderer.GetIndexCount(), renderer.GetVertexCount(), b_min, b_max);
-  if (texture != nullptr)
+  // AddMesh stages the geometry right away, nothing needs it afterwards
+  res.renderer_id = renderer.AddMesh(data.vertex_positions, data.vertex_attributes, data.vertex_format, data.indices,
+                                     data.meshlets, data.lods, data.b_min, data.b_max);
+
+  // The streamer reads mips out of the texture for as long as it lives, a cooked one stays a mapping. Moving keeps the
+  // spans valid, they point into heap storage or the mapping.
+  std::shared_ptr<const TextureData> texture;
+  if (keep_cpu_copy)
   {
-    res.texture_id = renderer.AddTexture({texture, static_cast<size_t>(texture_width * texture_height * 4)},
-                                         texture_width, texture_height);
+    res.cpu_copy = std::make_shared<MeshData>(std::move(data));
+    texture = std::shared_ptr<const TextureData>(res.cpu_copy, &res.cpu_copy->texture);
   } else
   {
-    res.texture_id = -1;
+    texture = std::make_shared<TextureData>(std::move(data.texture));
+  }
+
+  res.texture_id = -1;
+  if (!texture->empty())
+  {
+    res.texture_id = renderer.AddTexture(texture->format, texture->mips, texture->data, texture);
   }
   renderer.Upload();
 
   return res;
 }
+
+MeshResource MeshResourceLoader::operator()(const std::string &path, Engine *engine) const
+{
+  const bool block_compressed = engine->GetRenderer().SupportsBlockCompression();
+  return UploadMeshData(LoadMeshData(path, vertex_format, block_compressed), engine, keep_cpu_copy);
+}
+
+MeshData AsyncMeshResourceLoader::Load(const std::string &path) const
+{
+  return LoadMeshData(path, vertex_format, engine->GetRenderer().SupportsBlockCompression());
+}
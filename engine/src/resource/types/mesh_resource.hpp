@@ -1,18 +1,115 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <glm/glm.hpp>
+#include <memory>
+#include <span>
 #include <stdexcept>
 #include <string>
+#include <vector>
+
+#include "files/files.hpp"
+#include "render/vk_renderer.hpp"
+#include "resource/types/texture_resource.hpp"
 
 class Engine;
+struct MeshData;
 
 struct MeshResource
 {
   uint32_t renderer_id;
   int32_t texture_id;
+  // what the mesh was built from, only kept when the loader was asked to, for physics and picking
+  std::shared_ptr<const MeshData> cpu_copy;
+};
+
+// Everything a mesh needs before it touches the renderer, safe to build off the main thread.
+struct MeshData
+{
+  VertexFormat vertex_format = VertexFormat::kQuantized;
+  // vertices encoded in vertex_format, split into the two streams the gpu gets
+  std::span<const std::byte> vertex_positions;
+  std::span<const std::byte> vertex_attributes;
+  std::span<const uint32_t> indices; // all lods after each other, grouped by meshlet
+  std::span<const Meshlet> meshlets;
+  std::span<const MeshLod> lods; // at least one, lod 0 is the full mesh
+  glm::vec3 b_min{};
+  glm::vec3 b_max{};
+
+  std::string texture_path; // relative to engine/assets, empty if the mesh has none
+  TextureData texture;
+
+  // what the spans point into, either parsed data or the mapped cooked file
+  std::vector<Vertex> vertex_storage; // decoded, only while a source asset is processed
+  std::vector<std::byte> vertex_position_storage;
+  std::vector<std::byte> vertex_attribute_storage;
+  std::vector<uint32_t> index_storage;
+  std::vector<Meshlet> meshlet_storage;
+  std::vector<MeshLod> lod_storage;
+  files::MappedFile file;
+
+  [[nodiscard]] size_t VertexCount() const { return vertex_positions.size() / PositionStride(vertex_format); }
+  [[nodiscard]] size_t VertexBytes() const { return vertex_positions.size() + vertex_attributes.size(); }
+};
+
+struct MeshOptimizationStats
+{
+  // average cache miss ratio (vertex shader runs per triangle) and average transformed vertex ratio (runs per vertex)
+  float acmr_before{};
+  float acmr_after{};
+  float atvr_before{};
+  float atvr_after{};
+  float overdraw_before{};
+  float overdraw_after{};
 };
 
+// Reorders the triangles for the post transform vertex cache and then for overdraw, and the vertices for fetch
+// locality. Runs before the lods and meshlets are built, it doesn't change what the mesh looks like.
+MeshOptimizationStats OptimizeMesh(MeshData &data);
+// Appends simplified versions of the mesh to its indices, one lod each.
+void GenerateLods(MeshData &data);
+// Splits every lod into meshlets and reorders the indices so every meshlet is one contiguous range.
+void BuildMeshlets(MeshData &data);
+// Encodes vertex_storage into the two vertex streams and drops it. Quantized positions are relative to the mesh
+// bounds.
+void EncodeVertices(MeshData &data, VertexFormat format);
+
+// Parses the OBJ, doesn't load the texture.
+MeshData LoadObjMeshData(const std::string &path, VertexFormat format = VertexFormat::kQuantized);
+// Maps a .pmesh, doesn't load the texture.
+MeshData LoadCookedMeshData(const std::string &path);
+// Loads the cooked texture if there's an up to date one, builds the mips from the source image otherwise. Without
+// block_compressed the texture ends up rgba8.
+void LoadMeshTexture(MeshData &data, bool block_compressed = true);
+
+// Geometry plus texture. Takes .pmesh files or OBJs, OBJs with an up to date .pmesh of the same vertex format next to
+// them load that instead. A .pmesh keeps the format it was cooked with.
+MeshData LoadMeshData(const std::string &path, VertexFormat format = VertexFormat::kQuantized,
+                      bool block_compressed = true);
+// Once it's uploaded the geometry only lives on the gpu, the texture stays with the renderer for streaming. With
+// keep_cpu_copy the resource holds on to all of data.
+MeshResource UploadMeshData(MeshData &&data, Engine *engine, bool keep_cpu_copy = false);
+
 struct MeshResourceLoader
 {
+  VertexFormat vertex_format = VertexFormat::kQuantized;
+  bool keep_cpu_copy = false;
+
   MeshResource operator()(const std::string &path, Engine *engine) const;
 };
+
+// Parses on a load worker, uploads on the main thread. Precision sensitive meshes can ask for VertexFormat::kFull.
+struct AsyncMeshResourceLoader
+{
+  Engine *engine;
+  VertexFormat vertex_format = VertexFormat::kQuantized;
+  bool keep_cpu_copy = false;
+
+  // textures the device can't sample are decoded here, not in Finalize
+  [[nodiscard]] MeshData Load(const std::string &path) const;
+  [[nodiscard]] MeshResource Finalize(MeshData &&data) const
+  {
+    return UploadMeshData(std::move(data), engine, keep_cpu_copy);
+  }
+};
@@ -0,0 +1,92 @@
+#include "resource/types/texture_format.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#include "resource/types/texture_resource.hpp"
+#include "tracy/Tracy.hpp"
+
+namespace
+{
+  uint64_t AlignUp(const uint64_t value)
+  {
+    return (value + texture_format::kSectionAlignment - 1) & ~(texture_format::kSectionAlignment - 1);
+  }
+
+  template<typename T>
+  std::span<const T> GetSection(const std::span<const std::byte> file, const texture_format::Section& section)
+  {
+    if (section.offset + section.size > file.size() || section.size % sizeof(T) != 0)
+    {
+      throw std::runtime_error("Cooked texture section out of bounds");
+    }
+    return {reinterpret_cast<const T*>(file.data() + section.offset), section.size / sizeof(T)};
+  }
+} // namespace
+
+void texture_format::Write(const std::string& path, const TextureData& texture)
+{
+  ZoneScopedN("texture_format::Write");
+
+  Header header{.magic = kMagic, .version = kVersion, .format = texture.format, .mips = {}, .data = {}};
+
+  uint64_t offset = AlignUp(sizeof(Header));
+  const auto place = [&offset](Section& section, const uint64_t size)
+  {
+    section = {.offset = offset, .size = size};
+    offset = AlignUp(offset + size);
+  };
+  place(header.mips, texture.mips.size_bytes());
+  place(header.data, texture.data.size_bytes());
+
+  std::vector<std::byte> bytes(offset);
+  std::memcpy(bytes.data(), &header, sizeof(Header));
+  std::memcpy(bytes.data() + header.mips.offset, texture.mips.data(), header.mips.size);
+  std::memcpy(bytes.data() + header.data.offset, texture.data.data(), header.data.size);
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+  if (!file)
+  {
+    throw std::runtime_error("Failed to write cooked texture " + path);
+  }
+}
+
+void texture_format::Read(files::MappedFile file, TextureData& texture)
+{
+  ZoneScopedN("texture_format::Read");
+
+  const auto bytes = file.data();
+  if (bytes.size() < sizeof(Header))
+  {
+    throw std::runtime_error("Cooked texture too small");
+  }
+
+  Header header{};
+  std::memcpy(&header, bytes.data(), sizeof(Header));
+  if (header.magic != kMagic || header.version != kVersion ||
+      (header.format != TextureFormat::kRgba8 && header.format != TextureFormat::kBc1 &&
+       header.format != TextureFormat::kBc3))
+  {
+    throw std::runtime_error("Cooked texture has the wrong version");
+  }
+
+  texture.format = header.format;
+  texture.mips = GetSection<TextureMip>(bytes, header.mips);
+  texture.data = GetSection<std::byte>(bytes, header.data);
+  if (texture.mips.empty())
+  {
+    throw std::runtime_error("Cooked texture has no mips");
+  }
+  for (const auto& mip: texture.mips)
+  {
+    if (mip.offset + mip.size > texture.data.size() ||
+        mip.size != TextureMipBytes(texture.format, mip.width, mip.height))
+    {
+      throw std::runtime_error("Cooked texture section out of bounds");
+    }
+  }
+  texture.file = std::move(file);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include "files/files.hpp"
+#include "render/vk_renderer.hpp"
+
+struct TextureData;
+
+// Cooked texture container (.ptex). Holds the whole mip chain already in the format the gpu samples, so the runtime
+// can map the file and copy it to the staging buffer as is:
+//
+//   Header | mips | texel data
+//
+// every section starts at a kSectionAlignment aligned offset from the start of the file.
+namespace texture_format
+{
+  inline constexpr std::array<char, 4> kMagic{'P', 'T', 'E', 'X'};
+  inline constexpr uint32_t kVersion = 1;
+  inline constexpr uint64_t kSectionAlignment = 16;
+  inline constexpr const char* kExtension = ".ptex";
+
+  struct Section
+  {
+    uint64_t offset;
+    uint64_t size; // in bytes
+  };
+
+  struct Header
+  {
+    std::array<char, 4> magic;
+    uint32_t version;
+    TextureFormat format;
+    uint32_t padding{};
+
+    Section mips;
+    Section data;
+  };
+
+  // Throws on io errors.
+  void Write(const std::string& path, const TextureData& texture);
+
+  // Points texture's spans into the mapping and takes ownership of it. Throws if the file isn't a valid cooked texture
+  // of the current version.
+  void Read(files::MappedFile file, TextureData& texture);
+} // namespace texture_format
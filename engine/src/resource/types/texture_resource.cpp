@@ -0,0 +1,390 @@
+#include "resource/types/texture_resource.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "resource/types/texture_format.hpp"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#define STB_DXT_IMPLEMENTATION
+#include "stb_dxt.h"
+#include "tracy/Tracy.hpp"
+#include "util/print.hpp"
+
+namespace
+{
+  float SrgbToLinear(const float value)
+  {
+    return value <= 0.04045F ? value / 12.92F : std::pow((value + 0.055F) / 1.055F, 2.4F);
+  }
+
+  unsigned char LinearToSrgb(const float value)
+  {
+    const float srgb = value <= 0.0031308F ? value * 12.92F : (1.055F * std::pow(value, 1.0F / 2.4F)) - 0.055F;
+    return static_cast<unsigned char>(std::lround(std::clamp(srgb, 0.0F, 1.0F) * 255.0F));
+  }
+
+  // Box filters the level down to half its size. Odd sizes clamp the last row and column, so they count twice.
+  std::vector<unsigned char> Downsample(const std::span<const unsigned char> level, const uint32_t width,
+                                        const uint32_t height)
+  {
+    static const auto kToLinear = []
+    {
+      std::array<float, 256> table{};
+      for (size_t i{}; i < table.size(); i++)
+      {
+        table[i] = SrgbToLinear(static_cast<float>(i) / 255.0F);
+      }
+      return table;
+    }();
+
+    const uint32_t next_width = std::max(width / 2, 1U);
+    const uint32_t next_height = std::max(height / 2, 1U);
+    std::vector<unsigned char> next(static_cast<size_t>(next_width) * next_height * 4);
+
+    for (uint32_t y{}; y < next_height; y++)
+    {
+      const std::array<uint32_t, 2> rows{std::min(y * 2, height - 1), std::min((y * 2) + 1, height - 1)};
+      for (uint32_t x{}; x < next_width; x++)
+      {
+        const std::array<uint32_t, 2> columns{std::min(x * 2, width - 1), std::min((x * 2) + 1, width - 1)};
+
+        std::array<float, 4> sum{};
+        for (const auto row: rows)
+        {
+          for (const auto column: columns)
+          {
+            const auto *texel = &level[((static_cast<size_t>(row) * width) + column) * 4];
+            for (size_t c{}; c < 3; c++)
+            {
+              sum[c] += kToLinear[texel[c]];
+            }
+            sum[3] += static_cast<float>(texel[3]);
+          }
+        }
+
+        auto *out = &next[((static_cast<size_t>(y) * next_width) + x) * 4];
+        for (size_t c{}; c < 3; c++)
+        {
+          out[c] = LinearToSrgb(sum[c] / 4.0F);
+        }
+        out[3] = static_cast<unsigned char>(std::lround(sum[3] / 4.0F));
+      }
+    }
+
+    return next;
+  }
+
+  // Appends the level as 4x4 blocks, texels past the edge repeat the last row and column.
+  void CompressLevel(const std::span<const unsigned char> level, const uint32_t width, const uint32_t height,
+                     const TextureFormat format, std::vector<std::byte> &out)
+  {
+    const bool alpha = format == TextureFormat::kBc3;
+    const uint32_t block_bytes = TextureBlockBytes(format);
+
+    std::array<unsigned char, 16 * 4> block{};
+    for (uint32_t block_y{}; block_y < height; block_y += 4)
+    {
+      for (uint32_t block_x{}; block_x < width; block_x += 4)
+      {
+        for (uint32_t y{}; y < 4; y++)
+        {
+          for (uint32_t x{}; x < 4; x++)
+          {
+            const size_t row = std::min(block_y + y, height - 1);
+            const size_t column = std::min(block_x + x, width - 1);
+            std::memcpy(&block[((y * 4) + x) * 4], &level[((row * width) + column) * 4], 4);
+          }
+        }
+
+        const size_t offset = out.size();
+        out.resize(offset + block_bytes);
+        stb_compress_dxt_block(reinterpret_cast<unsigned char *>(out.data() + offset), block.data(), alpha ? 1 : 0,
+                               STB_DXT_HIGHQUAL);
+      }
+    }
+  }
+
+  using Rgba = std::array<uint8_t, 4>;
+
+  uint16_t ReadU16(const std::byte *bytes)
+  {
+    return static_cast<uint16_t>(std::to_integer<uint16_t>(bytes[0]) | (std::to_integer<uint16_t>(bytes[1]) << 8));
+  }
+
+  Rgba Unpack565(const uint16_t color)
+  {
+    const uint32_t r = (color >> 11) & 31;
+    const uint32_t g = (color >> 5) & 63;
+    const uint32_t b = color & 31;
+    return {static_cast<uint8_t>((r << 3) | (r >> 2)), static_cast<uint8_t>((g << 2) | (g >> 4)),
+            static_cast<uint8_t>((b << 3) | (b >> 2)), 255};
+  }
+
+  Rgba Mix(const Rgba &a, const Rgba &b, const uint32_t weight_a, const uint32_t weight_b)
+  {
+    Rgba mixed{};
+    for (size_t i{}; i < mixed.size(); i++)
+    {
+      mixed[i] = static_cast<uint8_t>((a[i] * weight_a + b[i] * weight_b) / (weight_a + weight_b));
+    }
+    return mixed;
+  }
+
+  // The 8 byte color half of a bc1 or bc3 block. bc3 always uses the four color mode.
+  void DecodeColorBlock(const std::byte *block, const bool always_four, std::array<Rgba, 16> &texels)
+  {
+    const uint16_t c0 = ReadU16(block);
+    const uint16_t c1 = ReadU16(block + 2);
+    std::array<Rgba, 4> palette{Unpack565(c0), Unpack565(c1)};
+    if (c0 > c1 || always_four)
+    {
+      palette[2] = Mix(palette[0], palette[1], 2, 1);
+      palette[3] = Mix(palette[0], palette[1], 1, 2);
+    } else
+    {
+      palette[2] = Mix(palette[0], palette[1], 1, 1);
+      palette[3] = {0, 0, 0, 0};
+    }
+
+    const uint32_t indices = ReadU16(block + 4) | (static_cast<uint32_t>(ReadU16(block + 6)) << 16);
+    for (uint32_t i{}; i < texels.size(); i++)
+    {
+      texels[i] = palette[(indices >> (i * 2)) & 3];
+    }
+  }
+
+  // The 8 byte alpha half of a bc3 block.
+  void DecodeAlphaBlock(const std::byte *block, std::array<Rgba, 16> &texels)
+  {
+    const auto a0 = std::to_integer<uint32_t>(block[0]);
+    const auto a1 = std::to_integer<uint32_t>(block[1]);
+    std::array<uint32_t, 8> palette{a0, a1};
+    if (a0 > a1)
+    {
+      for (uint32_t i = 1; i < 7; i++)
+      {
+        palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+      }
+    } else
+    {
+      for (uint32_t i = 1; i < 5; i++)
+      {
+        palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+      }
+      palette[6] = 0;
+      palette[7] = 255;
+    }
+
+    uint64_t indices{};
+    for (uint32_t i{}; i < 6; i++)
+    {
+      indices |= std::to_integer<uint64_t>(block[2 + i]) << (i * 8);
+    }
+    for (uint32_t i{}; i < texels.size(); i++)
+    {
+      texels[i][3] = static_cast<uint8_t>(palette[(indices >> (i * 3)) & 7]);
+    }
+  }
+
+  // Fills rgba_mips with the levels of the result.
+  std::vector<std::byte> DecodeBlocks(const TextureFormat format, const std::span<const TextureMip> mips,
+                                      const std::span<const std::byte> data, std::vector<TextureMip> &rgba_mips)
+  {
+    const uint32_t block_bytes = TextureBlockBytes(format);
+    uint64_t size{};
+    for (const auto &mip: mips)
+    {
+      if (mip.offset + mip.size > data.size() || mip.size != TextureMipBytes(format, mip.width, mip.height))
+      {
+        throw std::runtime_error("Texture mip out of bounds");
+      }
+      rgba_mips.push_back({.width = mip.width,
+                           .height = mip.height,
+                           .offset = size,
+                           .size = TextureMipBytes(TextureFormat::kRgba8, mip.width, mip.height)});
+      size += rgba_mips.back().size;
+    }
+
+    std::vector<std::byte> rgba(size);
+    std::array<Rgba, 16> texels{};
+    for (size_t level{}; level < mips.size(); level++)
+    {
+      const auto &mip = mips[level];
+      auto *out = rgba.data() + rgba_mips[level].offset;
+      const std::byte *block = data.data() + mip.offset;
+      for (uint32_t by{}; by < mip.height; by += 4)
+      {
+        for (uint32_t bx{}; bx < mip.width; bx += 4, block += block_bytes)
+        {
+          if (format == TextureFormat::kBc3)
+          {
+            DecodeColorBlock(block + 8, true, texels);
+            DecodeAlphaBlock(block, texels);
+          } else
+          {
+            DecodeColorBlock(block, false, texels);
+          }
+
+          // blocks at the edge of the small mips hang over it
+          for (uint32_t y{}; y < 4 && by + y < mip.height; y++)
+          {
+            for (uint32_t x{}; x < 4 && bx + x < mip.width; x++)
+            {
+              std::memcpy(out + ((by + y) * static_cast<uint64_t>(mip.width) + bx + x) * 4, texels[y * 4 + x].data(),
+                          4);
+            }
+          }
+        }
+      }
+    }
+    return rgba;
+  }
+} // namespace
+
+TextureData BuildTextureData(const std::span<const unsigned char> rgba, const uint32_t width, const uint32_t height,
+                             const bool compress)
+{
+  ZoneScopedN("BuildTextureData");
+
+  if (width == 0 || height == 0 || rgba.size() != static_cast<size_t>(width) * height * 4)
+  {
+    throw std::runtime_error("Texture size doesn't match its data");
+  }
+
+  TextureData texture{};
+  if (compress)
+  {
+    bool opaque = true;
+    for (size_t i = 3; i < rgba.size() && opaque; i += 4)
+    {
+      opaque = rgba[i] == 255;
+    }
+    texture.format = opaque ? TextureFormat::kBc1 : TextureFormat::kBc3;
+  }
+
+  std::vector<unsigned char> level(rgba.begin(), rgba.end());
+  uint32_t level_width = width;
+  uint32_t level_height = height;
+  while (true)
+  {
+    const uint64_t offset = texture.data_storage.size();
+    if (texture.format == TextureFormat::kRgba8)
+    {
+      const auto *bytes = reinterpret_cast<const std::byte *>(level.data());
+      texture.data_storage.insert(texture.data_storage.end(), bytes, bytes + level.size());
+    } else
+    {
+      CompressLevel(level, level_width, level_height, texture.format, texture.data_storage);
+    }
+    texture.mip_storage.push_back({.width = level_width,
+                                   .height = level_height,
+                                   .offset = offset,
+                                   .size = texture.data_storage.size() - offset});
+
+    if (level_width == 1 && level_height == 1)
+    {
+      break;
+    }
+    level = Downsample(level, level_width, level_height);
+    level_width = std::max(level_width / 2, 1U);
+    level_height = std::max(level_height / 2, 1U);
+  }
+
+  texture.mips = texture.mip_storage;
+  texture.data = texture.data_storage;
+  return texture;
+}
+
+TextureData LoadSourceTextureData(const std::string &path, const bool compress)
+{
+  ZoneScopedN("LoadSourceTextureData");
+
+  int32_t width{};
+  int32_t height{};
+  int32_t channels{};
+  auto *image = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+  if (image == nullptr)
+  {
+    throw std::runtime_error("Failed to load texture " + path);
+  }
+
+  const std::span<const unsigned char> rgba(image, static_cast<size_t>(width) * height * 4);
+  try
+  {
+    auto texture = BuildTextureData(rgba, static_cast<uint32_t>(width), static_cast<uint32_t>(height), compress);
+    stbi_image_free(image);
+    return texture;
+  } catch (...)
+  {
+    stbi_image_free(image);
+    throw;
+  }
+}
+
+TextureData DecodeTextureData(const TextureData &texture)
+{
+  ZoneScopedN("DecodeTextureData");
+
+  TextureData rgba{};
+  rgba.data_storage = DecodeBlocks(texture.format, texture.mips, texture.data, rgba.mip_storage);
+  rgba.mips = rgba.mip_storage;
+  rgba.data = rgba.data_storage;
+  return rgba;
+}
+
+TextureData LoadCookedTextureData(const std::string &path)
+{
+  files::MappedFile file(path);
+  if (!file)
+  {
+    throw std::runtime_error("Failed to open " + path);
+  }
+
+  TextureData texture{};
+  texture_format::Read(std::move(file), texture);
+  return texture;
+}
+
+TextureData LoadTextureData(const std::string &path, const bool block_compressed)
+{
+  ZoneScopedN("LoadTextureData");
+
+  const auto load_cooked = [block_compressed](const std::string &cooked_path)
+  {
+    auto texture = LoadCookedTextureData(cooked_path);
+    if (!block_compressed && texture.format != TextureFormat::kRgba8)
+    {
+      return DecodeTextureData(texture);
+    }
+    return texture;
+  };
+
+  const fs::path source(path);
+  if (source.extension() == texture_format::kExtension)
+  {
+    return load_cooked(path);
+  }
+
+  // use the cooked version when the cooker ran after the source was last touched
+  auto cooked = source;
+  cooked.replace_extension(texture_format::kExtension);
+  std::error_code error;
+  const bool up_to_date =
+      fs::exists(cooked, error) && fs::last_write_time(cooked, error) >= fs::last_write_time(source, error);
+  if (up_to_date && !error)
+  {
+    try
+    {
+      return load_cooked(cooked.string());
+    } catch (const std::exception &err)
+    {
+      util::println("Ignoring cooked texture {}: {}", cooked.string(), err.what());
+    }
+  }
+
+  return LoadSourceTextureData(path, block_compressed);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "files/files.hpp"
+#include "render/vk_renderer.hpp"
+
+// A texture with its whole mip chain, already in the format the gpu samples. Safe to build off the main thread.
+struct TextureData
+{
+  TextureFormat format = TextureFormat::kRgba8;
+  std::span<const TextureMip> mips; // level 0 first, empty if there's no texture
+  std::span<const std::byte> data;
+
+  // what the spans point into, either built data or the mapped cooked file
+  std::vector<TextureMip> mip_storage;
+  std::vector<std::byte> data_storage;
+  files::MappedFile file;
+
+  [[nodiscard]] bool empty() const { return mips.empty(); }
+  [[nodiscard]] uint32_t width() const { return mips.empty() ? 0 : mips.front().width; }
+  [[nodiscard]] uint32_t height() const { return mips.empty() ? 0 : mips.front().height; }
+};
+
+// Builds the full mip chain of an srgb rgba8 image, averaging in linear space. Every level is block compressed unless
+// compress is false, bc1 if the image is opaque and bc3 if it isn't.
+TextureData BuildTextureData(std::span<const unsigned char> rgba, uint32_t width, uint32_t height,
+                             bool compress = true);
+
+// Decodes an image stb_image can read and builds it.
+TextureData LoadSourceTextureData(const std::string &path, bool compress = true);
+// Maps a .ptex.
+TextureData LoadCookedTextureData(const std::string &path);
+// Decodes a block compressed texture to rgba8, for devices without bc support. Throws if the mips don't fit the data.
+TextureData DecodeTextureData(const TextureData &texture);
+// Takes .ptex files or source images, source images with an up to date .ptex next to them load that instead. Throws if
+// the image can't be read. Without block_compressed the result is always rgba8.
+TextureData LoadTextureData(const std::string &path, bool block_compressed = true);
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <optional>
+
+namespace util
+{
+  // First fit offset allocator over [0, capacity). It only hands out offsets, the memory itself lives somewhere else
+  // (usually a GPU buffer). Units are whatever the owner decides (bytes, vertices, indices, ...).
+  class RangeAllocator
+  {
+  public:
+    explicit RangeAllocator(const uint64_t capacity = 0) { Grow(capacity); }
+
+    std::optional<uint64_t> Allocate(const uint64_t size, const uint64_t alignment = 1)
+    {
+      if (size == 0)
+      {
+        return std::nullopt;
+      }
+
+      for (auto iter = free_.begin(); iter != free_.end(); ++iter)
+      {
+        const auto [block_offset, block_size] = *iter;
+        const uint64_t aligned = (block_offset + alignment - 1) / alignment * alignment;
+        const uint64_t padding = aligned - block_offset;
+        if (padding + size > block_size)
+        {
+          continue;
+        }
+
+        free_.erase(iter);
+        if (padding > 0)
+        {
+          free_.emplace(block_offset, padding);
+        }
+        if (padding + size < block_size)
+        {
+          free_.emplace(aligned + size, block_size - padding - size);
+        }
+
+        used_ += size;
+        return aligned;
+      }
+
+      return std::nullopt;
+    }
+
+    void Free(const uint64_t offset, const uint64_t size)
+    {
+      if (size == 0)
+      {
+        return;
+      }
+
+      used_ -= size;
+      auto [iter, inserted] = free_.emplace(offset, size);
+
+      // merge with next block
+      const auto next = std::next(iter);
+      if (next != free_.end() && iter->first + iter->second == next->first)
+      {
+        iter->second += next->second;
+        free_.erase(next);
+      }
+
+      // merge with previous block
+      if (iter != free_.begin())
+      {
+        const auto prev = std::prev(iter);
+        if (prev->first + prev->second == iter->first)
+        {
+          prev->second += iter->second;
+          free_.erase(iter);
+        }
+      }
+    }
+
+    // Extends the range, existing allocations keep their offsets.
+    void Grow(const uint64_t new_capacity)
+    {
+      if (new_capacity <= capacity_)
+      {
+        return;
+      }
+
+      const uint64_t old_capacity = capacity_;
+      capacity_ = new_capacity;
+      used_ += new_capacity - old_capacity;
+      Free(old_capacity, new_capacity - old_capacity);
+    }
+
+    [[nodiscard]] uint64_t capacity() const { return capacity_; }
+    [[nodiscard]] uint64_t used() const { return used_; }
+    // More than one means there are holes between allocations.
+    [[nodiscard]] size_t free_blocks() const { return free_.size(); }
+
+  private:
+    std::map<uint64_t, uint64_t> free_; // offset -> size
+    uint64_t capacity_ = 0;
+    uint64_t used_ = 0;
+  };
+} // namespace util
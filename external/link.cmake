@@ -5,6 +5,7 @@ target_link_libraries(engine PUBLIC Vulkan::Vulkan)
 target_link_libraries(engine PUBLIC Tracy::TracyClient)
 
 target_link_libraries(engine PUBLIC stb)
+target_link_libraries(engine PUBLIC meshoptimizer)
 
 target_link_libraries(engine PUBLIC vma)
 
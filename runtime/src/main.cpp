@@ -20,35 +20,40 @@ struct RuntimeApplication
 
     const auto cat_entity = engine->GetScene().Create();
 
-    auto* cat_transform = engine->GetScene().AddComponent<CTransform>(cat_entity, glm::mat4(1.0F));
-    cat_transform->world = glm::translate(cat_transform->world, glm::vec3(0.0F, -20.0F, 0.0F));
-    cat_transform->world = glm::scale(cat_transform->world, glm::vec3(10.0F, 10.0F, 10.0F));
-    cat_transform->world = glm::rotate(cat_transform->world, glm::radians(180.0F), glm::vec3(1.0F, 0.0F, 0.0F));
-
-    const auto cat_mesh = engine->GetResourceManager().load<MeshResource>(
-        "catMesh", MeshResourceLoader{}, (root_path / "engine/assets/concrete_cat_statue_1k.obj").string(), engine);
+    engine->GetScene().AddComponent<CLocalTransform>(
+        cat_entity,
+        CLocalTransform{.position = glm::vec3(0.0F, -20.0F, 0.0F),
+                        .rotation = glm::angleAxis(glm::radians(180.0F), glm::vec3(1.0F, 0.0F, 0.0F)),
+                        .scale = glm::vec3(10.0F)});
+
+    const auto cat_mesh = engine->GetResourceManager().LoadAsync<MeshResource>(
+        "catMesh", AsyncMeshResourceLoader{engine}, (root_path / "engine/assets/concrete_cat_statue_1k.obj").string());
     engine->GetScene().AddComponent<CMesh>(cat_entity, cat_mesh);
 
     const auto wall_entity = engine->GetScene().Create();
 
-    auto* wall_transform = engine->GetScene().AddComponent<CTransform>(wall_entity, glm::mat4(1.0F));
-    wall_transform->world = glm::translate(wall_transform->world, glm::vec3(30.0F, 0.0F, 180.0F));
-    wall_transform->world = glm::scale(wall_transform->world, glm::vec3(1.2F, 1.0F, 1.0F));
+    engine->GetScene().AddComponent<CLocalTransform>(
+        wall_entity,
+        CLocalTransform{.position = glm::vec3(30.0F, 0.0F, 180.0F), .scale = glm::vec3(1.2F, 1.0F, 1.0F)});
 
-    const auto wall_mesh = engine->GetResourceManager().load<MeshResource>(
-        "wallMesh", MeshResourceLoader{}, (root_path / "engine/assets/wall.obj").string(), engine);
+    const auto wall_mesh = engine->GetResourceManager().LoadAsync<MeshResource>(
+        "wallMesh", AsyncMeshResourceLoader{engine}, (root_path / "engine/assets/wall.obj").string());
     engine->GetScene().AddComponent<CMesh>(wall_entity, wall_mesh);
 
     camera_entity = engine->GetScene().Create();
     engine->GetScene().AddComponent<CTransform>(camera_entity, glm::mat4(1.0F));
     engine->GetScene().AddComponent<CCamera>(camera_entity, 70.0F);
 
-    const auto cylinder_mesh = engine->GetResourceManager().load<MeshResource>(
-        "firstmesh", MeshResourceLoader{}, (root_path / "engine/assets/cylinder.obj").string(), engine);
-    const auto icosphere_mesh = engine->GetResourceManager().load<MeshResource>(
-        "secondmesh", MeshResourceLoader{}, (root_path / "engine/assets/icosphere.obj").string(), engine);
+    const auto cylinder_mesh = engine->GetResourceManager().LoadAsync<MeshResource>(
+        "firstmesh", AsyncMeshResourceLoader{engine}, (root_path / "engine/assets/cylinder.obj").string());
+    const auto icosphere_mesh = engine->GetResourceManager().LoadAsync<MeshResource>(
+        "secondmesh", AsyncMeshResourceLoader{engine}, (root_path / "engine/assets/icosphere.obj").string());
 
     constexpr int grid_size = 100;
+    const auto grid_entity = engine->GetScene().Create();
+    engine->GetScene().AddComponent<CLocalTransform>(
+        grid_entity, CLocalTransform{.position = glm::vec3(-static_cast<float>(grid_size), 6.0F, -100.0F)});
+
     for (int j{}; j < grid_size; ++j)
     {
       for (int i{}; i < grid_size; ++i)
@@ -57,12 +62,9 @@ struct RuntimeApplication
 
         const auto entity = engine->GetScene().Create();
 
-        auto* transform_component = engine->GetScene().AddComponent<CTransform>(entity);
-        transform_component->world = glm::translate(
-            glm::mat4(1.0F), glm::vec3(static_cast<float>(j) * spacing, 0.0F, static_cast<float>(i) * spacing));
-        transform_component->world =
-            glm::translate(transform_component->world, glm::vec3(-static_cast<float>(grid_size), 6.0F, -100.0F));
-        transform_component->world = glm::scale(transform_component->world, glm::vec3(1.0F));
+        const glm::vec3 position(static_cast<float>(j) * spacing, 0.0F, static_cast<float>(i) * spacing);
+        engine->GetScene().AddComponent<CLocalTransform>(entity, CLocalTransform{.position = position});
+        engine->GetScene().AddComponent<CParent>(entity, static_cast<entt::entity>(grid_entity));
 
         if ((i + j) % 2 == 0)
         {